@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/async/simpleExecutor.hpp"
+#include "../structures/async/asyncFunnelCounter.hpp"
+
+// One request handler of the async benchmark: increment, do some work, yield
+// to the executor, repeat. --impl=async co_awaits the AsyncFunnelCounter,
+// --impl=blocking calls TargetCounter::fetch_add and so holds its worker
+// thread while the funnel makes it wait.
+ASYNC_EXECUTOR::Detached async_benchmark_task(ASYNC_EXECUTOR::SimpleExecutor &executor, ASYNC_FUNNEL::AsyncFunnelCounter<long long> *async_counter,
+                                              TargetCounter *counter, int id, int additional_work, int seed,
+                                              std::atomic<bool> &stop, std::atomic<int> &live, RunResult &result)
+{
+    co_await executor.schedule();
+    int rd_work = 0;
+    auto rd_gen = get_mt_generator(seed);
+    while (!stop.load())
+    {
+        if (async_counter != nullptr)
+            co_await async_counter->async_fetch_add(1, id, executor);
+        else
+            counter->fetch_add(1, executor.worker_id());
+        result.op_counts[1]++;
+        result.total_count++;
+
+        if (additional_work > 1)
+        {
+            int x = 1;
+            while (x % additional_work != 0)
+            {
+                x = rd_gen() % additional_work;
+                rd_work++;
+            }
+        }
+        co_await executor.schedule();
+    }
+    result.random_work = rd_work;
+    live.fetch_sub(1);
+}
+
+// task_count coroutines run on an executor with thread_count workers
+// (--mode=async) until the time is up
+void run_async_benchmark(int thread_count, int run_milliseconds, int additional_work, int task_count, std::string impl)
+{
+    ASYNC_FUNNEL::AsyncFunnelCounter<long long> *async_counter = nullptr;
+    TargetCounter *counter = nullptr;
+    if (impl == "async")
+        async_counter = new ASYNC_FUNNEL::AsyncFunnelCounter<long long>(task_count);
+    else if (impl == "blocking")
+        counter = get_target_counter(thread_count);
+    else
+        throw std::runtime_error("Unknown async implementation: " + impl);
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    std::vector<RunResult> results(task_count);
+    std::atomic<bool> stop(false);
+    std::atomic<int> live(task_count);
+    Timer timer;
+    {
+        ASYNC_EXECUTOR::SimpleExecutor executor(thread_count);
+        std::cout << " --- Starting tasks --- " << std::endl;
+        timer.start();
+        for (int i = 0; i < task_count; i++)
+            async_benchmark_task(executor, async_counter, counter, i, additional_work, core_seed * 1000 + i, stop, live, results[i]);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        while (live.load() != 0)
+            std::this_thread::yield();
+        timer.stop();
+        std::cout << " --- Stopped all tasks --- " << std::endl;
+    }
+
+    long long total_count = 0;
+    for (int i = 0; i < task_count; i++)
+    {
+        total_count += results[i].total_count;
+        std::cerr << "Task " << i << " : " << results[i].total_count << " ___ " << results[i].random_work << std::endl;
+    }
+    long long final_value = async_counter != nullptr ? async_counter->load() : counter->load();
+#if defined(AUX_DATA) && AUX_DATA != 0
+    long long root_access = async_counter != nullptr ? async_counter->root_access() : counter->root_access();
+#else
+    long long root_access = 0;
+#endif
+    delete async_counter;
+    delete counter;
+    if (final_value != total_count)
+        throw std::runtime_error("Counter ended at " + std::to_string(final_value) + " after " + std::to_string(total_count) + " increments");
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " ops/ms" << std::endl;
+#if defined(AUX_DATA) && AUX_DATA != 0
+    std::cout << "Ops per root access: " << std::fixed << std::setprecision(2) << (double)total_count / std::max(root_access, 1LL) << std::endl;
+#endif
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,impl,task_count,total_count,root_access,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << impl << "," << task_count;
+    summary_file << "," << total_count << "," << root_access << "," << ms << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "task_id,op_count" << std::endl;
+    for (int i = 0; i < task_count; i++)
+        aux_file << i << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/counter/funnelRef.hpp"
+
+// A counter that lives in an existing struct, next to fields the benchmark
+// does not touch
+struct alignas(128) AttachedStats
+{
+    long long requests = 0;
+    std::atomic<long long> hits;
+    long long errors = 0;
+};
+
+// All threads read and increment one std::atomic<long long> field
+// (--mode=attach). The first direct_count threads increment it with a plain
+// fetch_add. The others go through a FunnelRef attached to the same word.
+// Reads are plain loads of the word for everyone, so --direct=<thread_count>
+// is the unmodified atomic.
+void run_attach_benchmark(int thread_count, int run_milliseconds, int read_percent, int additional_work, long long diff_range, int direct_count)
+{
+    direct_count = std::max(0, std::min(direct_count, thread_count));
+    AttachedStats stats;
+    stats.hits.store(0);
+    int funnel_count = std::max(thread_count - direct_count, 1);
+    FUNNEL_REF::FunnelRef<long long> *funnel = new FUNNEL_REF::FunnelRef<long long>(stats.hits, funnel_count);
+
+    const int ratios[2] = {read_percent, 100 - read_percent};
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    RunResult results[thread_count];
+    long long sums[thread_count];
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        auto thread_func = [&](int id)
+        {
+            auto gen = CounterOperationGenerator(core_seed * 1000 + id, ratios, diff_range);
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+            bool direct = id < direct_count;
+            long long sum = 0;
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                auto op = gen.next();
+                if (std::get<0>(op) == 0)
+                    rd_work += stats.hits.load();
+                else
+                {
+                    long long diff = std::get<1>(op);
+                    if (direct)
+                        rd_work += stats.hits.fetch_add(diff);
+                    else
+                        rd_work += funnel->fetch_add(diff, id - direct_count);
+                    sum += diff;
+                }
+                result.op_counts[std::get<0>(op)]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+            sums[id] = sum;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+    delete funnel;
+
+    long long total_count = 0, direct_ops = 0, funnel_ops = 0, expected = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        expected += sums[i];
+        (i < direct_count ? direct_ops : funnel_ops) += results[i].total_count;
+        std::cerr << "Thread " << i << (i < direct_count ? " (direct) : " : " (funnel) : ") << results[i].op_counts[0] << " " << results[i].op_counts[1] << " ___ " << results[i].random_work << std::endl;
+    }
+    if (stats.hits.load() != expected)
+        throw std::runtime_error("Attached word does not add up");
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " ops/ms" << std::endl;
+    std::cout << "Direct threads: " << std::fixed << std::setprecision(2) << direct_ops / ms << " ops/ms" << std::endl;
+    std::cout << "Funnel threads: " << std::fixed << std::setprecision(2) << funnel_ops / ms << " ops/ms" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,read_percent,additional_work,diff_range,direct_count,total_count,direct_ops,funnel_ops,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << read_percent << "," << additional_work << "," << diff_range << "," << direct_count;
+    summary_file << "," << total_count << "," << direct_ops << "," << funnel_ops << "," << ms << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,direct,read_count,increment_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << (i < direct_count) << "," << results[i].op_counts[0] << "," << results[i].op_counts[1] << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+#include <barrier>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/sync/funnelBarrier.hpp"
+
+// std::barrier behind the FunnelBarrier interface
+class StdBarrier
+{
+    std::barrier<> barrier;
+
+public:
+    StdBarrier(int participants) : barrier(participants) {}
+    void arrive_and_wait(int thread_id) { barrier.arrive_and_wait(); }
+};
+
+// MemoryBarrier is single use, so episodes rotate through a few of them.
+// Thread 0 re-arms the one two episodes ahead: nobody can reach it before
+// thread 0 arrives at the next episode, and its last use is long finished.
+class MemoryBarrierRing
+{
+    static const int RING = 4;
+    std::vector<MemoryBarrier *> ring;
+    std::vector<long long> episode;
+    int participants;
+
+public:
+    MemoryBarrierRing(int participants) : episode(participants, 0), participants(participants)
+    {
+        for (int i = 0; i < RING; i++)
+            ring.push_back(new MemoryBarrier(participants));
+    }
+    ~MemoryBarrierRing()
+    {
+        for (auto b : ring)
+            delete b;
+    }
+    void arrive_and_wait(int thread_id)
+    {
+        long long e = episode[thread_id]++;
+        ring[e % RING]->wait();
+        if (thread_id == 0)
+            ring[(e + 2) % RING]->count_to.store(participants);
+    }
+};
+
+// Every thread does its additional work and then waits at the barrier, over
+// and over (--mode=barrier). Thread 0 decides before each episode whether it
+// is the last one; decisions alternate between two slots, so a slot is only
+// rewritten once everyone has read it.
+template <typename Barrier>
+void barrier_benchmark_loop(int thread_count, int run_milliseconds, int additional_work, RunResult results[], Timer &timer)
+{
+    Barrier *episode_barrier = new Barrier(thread_count);
+    alignas(64) std::atomic<bool> last_episode[2] = {false, false};
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        // op_counts[1] are episodes
+        auto thread_func = [&](int id)
+        {
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            for (long long e = 0;; e++)
+            {
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+
+                if (id == 0)
+                    last_episode[e % 2].store(stop.load());
+                episode_barrier->arrive_and_wait(id);
+                result.op_counts[1]++;
+                result.total_count++;
+                if (last_episode[e % 2].load())
+                    break;
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+    delete episode_barrier;
+}
+
+// --impl=funnel is FunnelBarrier over TargetCounter, so the hardwareCounter
+// target is the centralized sense-reversing barrier on one atomic
+void run_barrier_benchmark(int thread_count, int run_milliseconds, int additional_work, std::string impl, std::string wait)
+{
+    using namespace FUNNEL_BARRIER;
+    RunResult results[thread_count];
+    Timer timer;
+    if (impl == "std")
+        barrier_benchmark_loop<StdBarrier>(thread_count, run_milliseconds, additional_work, results, timer);
+    else if (impl == "memory")
+        barrier_benchmark_loop<MemoryBarrierRing>(thread_count, run_milliseconds, additional_work, results, timer);
+    else if (impl == "funnel" && wait == "park")
+        barrier_benchmark_loop<FunnelBarrier<TargetCounter, WAIT_POLICY::ParkWait>>(thread_count, run_milliseconds, additional_work, results, timer);
+    else if (impl == "funnel")
+        barrier_benchmark_loop<FunnelBarrier<TargetCounter, WAIT_POLICY::SpinWait>>(thread_count, run_milliseconds, additional_work, results, timer);
+    else
+        throw std::runtime_error("Unknown barrier: " + impl);
+
+    long long episodes = results[0].op_counts[1];
+    for (int i = 0; i < thread_count; i++)
+    {
+        if (results[i].op_counts[1] != episodes)
+            throw std::runtime_error("Threads went through different numbers of episodes");
+        std::cerr << "Thread " << i << " : " << results[i].op_counts[1] << " episodes ___ " << results[i].random_work << std::endl;
+    }
+    double ms = timer.elapsed();
+
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Episodes: " << episodes << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << episodes / ms * 1000 << " episodes/s" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,impl,wait,episodes,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << impl << "," << wait;
+    summary_file << "," << episodes << "," << ms << "," << episodes / ms * 1000 << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,episodes,random_work" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].op_counts[1] << "," << results[i].random_work << std::endl;
+    aux_file.close();
+}
@@ -14,62 +14,67 @@
 #include <queue>
 #include <iomanip>
 #include <fstream>
+#include <map>
 
 #include "benchmarkUtils.hpp"
-
-typedef std::tuple<int, long long> CounterOperation;
-typedef std::tuple<long long, long long, std::vector<RunResult>> ResultsSummary;
-class CounterOperationGenerator
+#include "latencyHistogram.hpp"
+#include "threadPlacement.hpp"
+#include "queueBenchmark.hpp"
+#include "keyedBenchmark.hpp"
+#include "idBenchmark.hpp"
+#include "semaphoreBenchmark.hpp"
+#include "lockBenchmark.hpp"
+#include "barrierBenchmark.hpp"
+#include "refCountBenchmark.hpp"
+#include "schedulerBenchmark.hpp"
+#include "logBenchmark.hpp"
+#include "sharedBenchmark.hpp"
+#include "durableBenchmark.hpp"
+#include "asyncBenchmark.hpp"
+#include "attachBenchmark.hpp"
+#include "shardedBenchmark.hpp"
+
+// Latencies in time stamp counter ticks. With AUX_DATA every increment is
+// also filed under delegate when the thread's root access count moved during
+// it, i.e. it applied its batch to the root itself, and under waiter
+// otherwise. Without AUX_DATA that count does not exist and the split stays
+// empty.
+struct LatencySummary
 {
-private:
-    int seed;
-    static const int OP_TYPES = 2;
-
-    int ratios_sum[OP_TYPES] = {100, 0}; // read, increment
-    long long diff_range;
-    std::mt19937 mtg;
+    LatencyHistogram read, increment, delegate, waiter;
+    double ns_per_tick = 0;
 
-public:
-    CounterOperationGenerator(int seed, const int ratios[], long long diff_range)
+    void merge(const LatencySummary &other)
     {
-        this->seed = seed;
-        this->diff_range = diff_range;
-
-        ratios_sum[0] = ratios[0];
-        for (int i = 1; i < OP_TYPES; i++)
-            ratios_sum[i] = ratios_sum[i - 1] + ratios[i];
-        mtg = std::mt19937(seed);
+        read.merge(other.read);
+        increment.merge(other.increment);
+        delegate.merge(other.delegate);
+        waiter.merge(other.waiter);
     }
+};
 
-    CounterOperation next()
-    {
-        int op_rd = mtg() % 100;
-        int op = -1;
-        for (int i = 0; i < OP_TYPES; i++)
-        {
-            if (op_rd < ratios_sum[i])
-            {
-                op = i;
-                break;
-            }
-        }
+// max_access, root_access, per-thread results, latencies, CPU of each thread
+typedef std::tuple<long long, long long, std::vector<RunResult>, LatencySummary, std::vector<int>> ResultsSummary;
 
-        if (op == 0) // read
-        {
-            return CounterOperation(0, -1);
-        }
-        else if (op == 1) // insert
-        {
-            long long diff = (((1LL * mtg()) << 30) + mtg()) % diff_range + 1;
-            // int diff = 1;
-            return CounterOperation(1, diff);
-        }
-        else
-            throw std::runtime_error("Invalid operation");
-    }
-};
+// Latency sampling is off by default, so throughput stays comparable with
+// runs that did not read the time stamp counter
+static const int LATENCY_SAMPLE_STEPS = 0;
 
-ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_milliseconds, int read_percent, int increment_percent, int additional_work, long long diff_range)
+long long thread_root_access(TargetCounter *counter, int thread_id)
+{
+#if defined(AUX_DATA) && AUX_DATA != 0
+    RunResult aux;
+    counter->update_aux_data(thread_id, aux);
+    return aux.root_access;
+#else
+    return 0;
+#endif
+}
+
+// latency_steps: record every latency_steps-th operation of each thread, 1
+// for all of them and 0 for none. placement: CPU to pin each thread to, -1
+// to leave it to the scheduler.
+ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_milliseconds, int read_percent, int increment_percent, int additional_work, long long diff_range, long long deadline_ns, bool balanced, int latency_steps, const std::vector<int> &placement)
 {
     TargetCounter *counter = get_target_counter(thread_count);
 
@@ -81,8 +86,11 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
 
     std::atomic<long long> mirror_counter(0);
     RunResult results[thread_count];
+    std::vector<LatencySummary> latencies(thread_count);
+    std::vector<int> cpus(thread_count, -1);
+    TscCalibration calibration;
     {
-        MemoryBarrier barrier = MemoryBarrier(thread_count + 1);
+        HarnessBarrier barrier(thread_count + 1);
         std::atomic<bool> start(false);
         std::atomic<bool> stop(false);
 
@@ -91,14 +99,18 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
         {
             auto seed = core_seed * 1000 + id;
             std::string tid_hex = get_hex_thread_id();
-            auto gen = CounterOperationGenerator(seed, ratios, diff_range);
+            auto gen = CounterOperationGenerator(seed, ratios, diff_range, balanced);
             long long count = 0;
 
             int rd_work = 0;
             auto rd_gen = get_mt_generator(seed);
 
             RunResult result;
-            barrier.wait();
+            LatencySummary latency;
+            int until_sample = latency_steps;
+            THREAD_PLACEMENT::pin_current_thread(placement[id]);
+            cpus[id] = sched_getcpu();
+            barrier.arrive_and_wait(id);
 
             std::string s = "Thread " + std::to_string(id) + " = " + tid_hex + " started\n";
             std::cerr << s;
@@ -106,17 +118,44 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
             while (!stop.load())
             {
                 auto op = gen.next();
+                bool sampled = latency_steps > 0 && --until_sample == 0;
+                if (sampled)
+                    until_sample = latency_steps;
                 if (std::get<0>(op) == 0)
                 { // read
+                    unsigned long long begin_tsc = sampled ? read_tsc() : 0;
                     int res = counter->load();
                     rd_work += res;
+                    if (sampled)
+                        latency.read.record(read_tsc() - begin_tsc);
                 }
                 else if (std::get<0>(op) == 1)
                 { // increment
                     long long diff = std::get<1>(op);
-                    long long res = counter->fetch_add(diff, id);
+                    long long res = 0;
+                    long long root_before = sampled ? thread_root_access(counter, id) : 0;
+                    unsigned long long begin_tsc = sampled ? read_tsc() : 0;
+                    if (deadline_ns > 0)
+                    {
+                        auto begin = std::chrono::steady_clock::now();
+                        if (!counter->try_fetch_add(diff, id, begin + std::chrono::nanoseconds(deadline_ns), res))
+                            result.timeout_count++;
+                    }
+                    else
+                        res = counter->fetch_add(diff, id);
+                    if (sampled)
+                    {
+                        unsigned long long ticks = read_tsc() - begin_tsc;
+                        latency.increment.record(ticks);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                        if (thread_root_access(counter, id) != root_before)
+                            latency.delegate.record(ticks);
+                        else
+                            latency.waiter.record(ticks);
+#endif
+                    }
                     rd_work += res;
-                    count += diff;
+                    count += diff; // a timed out increment is still applied
                 }
                 else
                     continue;
@@ -139,6 +178,7 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
             counter->update_aux_data(id, result);
 #endif
             results[id] = result;
+            latencies[id] = std::move(latency);
         };
 
         std::cout << " --- Starting threads --- " << std::endl;
@@ -151,7 +191,8 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
 
         // start running and wait
         timer.start();
-        barrier.wait();
+        calibration.start();
+        barrier.arrive_and_wait(thread_count);
         std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
 
         // stop threads
@@ -159,6 +200,7 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
         for (auto &t : threads)
             t.join();
         timer.stop();
+        calibration.stop();
 
         std::cout << " --- Stopped all threads --- " << std::endl;
     }
@@ -176,20 +218,307 @@ ResultsSummary run_benchmark(Timer &timer, int thread_count, int run_millisecond
 #endif
 
     std::vector<RunResult> results_vec;
+    LatencySummary latency_summary;
+    latency_summary.ns_per_tick = calibration.ns_per_tick();
     for (int i = 0; i < thread_count; i++)
     {
         results_vec.push_back(results[i]);
+        latency_summary.merge(latencies[i]);
     }
     delete counter;
 
-    return ResultsSummary(max_access, root_access, results_vec);
+    return ResultsSummary(max_access, root_access, results_vec, latency_summary, cpus);
 }
 
 int main(int argc, char const *argv[])
 {
+    // --key=value options may appear anywhere and are taken out of argv
+    std::map<std::string, std::string> options;
+    int positional = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) == 0)
+        {
+            size_t eq = arg.find('=');
+            options[arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2)] = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        }
+        else
+            argv[positional++] = argv[i];
+    }
+    argc = positional;
+
     if (argc < 3)
     {
-        std::cout << "Usage: " << argv[0] << " <thread_count> <run_milliseconds> [read_percent] [increment_percent] [additional_work] [diff_range]" << std::endl;
+        std::cout << "Usage: " << argv[0] << " [--balanced] [--latency=N] [--pin=none|compact|scatter|smt-last|socket-fill] <thread_count> <run_milliseconds> [read_percent] [increment_percent] [additional_work] [diff_range] [deadline_ns]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=queue [--capacity=N] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=keyed [--keys=N] [--zipf=S] <thread_count> <run_milliseconds> [read_percent] [increment_percent] [additional_work] [diff_range]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=ids [--max-lease=N] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=semaphore [--impl=funnel|std] [--wait=spin|park] [--permits=N] [--k=K] [--bounded] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=lock [--lock=ticket|rw|ttas] [--wait=spin|park] [--cs=N] <thread_count> <run_milliseconds> [read_percent] [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=barrier [--impl=funnel|memory|std] [--wait=spin|park] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=refcount [--impl=funnel|atomic] [--objects=N] [--read=N] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=parallel-for [--schedule=fixed|guided|trapezoid] [--chunk=N] [--iterations=N] [--workload=uniform|increasing|random] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=log [--record=BYTES] [--segment=BYTES] [--segments=N] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=multiprocess [--impl=funnel|atomic] [--processes=N] [--fanout=N] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=durable [--chunk=N] [--file=PATH] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=async [--impl=async|blocking] [--tasks=N] <thread_count> <run_milliseconds> [additional_work]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=attach [--direct=N] <thread_count> <run_milliseconds> [read_percent] [additional_work] [diff_range]" << std::endl;
+        std::cout << "       " << argv[0] << " --mode=sharded [--impl=sharded|counter] [--read=approx|snapshot] <thread_count> <run_milliseconds> [read_percent] [additional_work] [diff_range]" << std::endl;
+        return 1;
+    }
+    std::string mode = options.count("mode") ? options["mode"] : "counter";
+    if (mode == "queue")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        long long capacity = options.count("capacity") ? std::stoll(options["capacity"]) : 1LL << 16;
+        std::cout << "Mode:                \tqueue" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Capacity:            \t" << capacity << std::endl;
+        run_queue_benchmark(thread_count, run_milliseconds, additional_work, capacity);
+        return 0;
+    }
+    else if (mode == "keyed")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int read_percent = (argc > 3) ? std::stoi(argv[3]) : 50;
+        int increment_percent = (argc > 4) ? std::stoi(argv[4]) : 100 - read_percent;
+        int additional_work = (argc > 5) ? std::stoi(argv[5]) : 32;
+        long long diff_range = (argc > 6) ? std::stoll(argv[6]) : 100LL;
+        int key_count = options.count("keys") ? std::stoi(options["keys"]) : 1024;
+        double zipf = options.count("zipf") ? std::stod(options["zipf"]) : 0.0; // 0: uniform
+        std::cout << "Mode:                \tkeyed" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Read percent:        \t" << read_percent << std::endl;
+        std::cout << "Increment percent:   \t" << increment_percent << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Diff range:          \t" << diff_range << std::endl;
+        std::cout << "Key count:           \t" << key_count << std::endl;
+        std::cout << "Zipf exponent:       \t" << zipf << std::endl;
+        run_keyed_benchmark(thread_count, run_milliseconds, read_percent, increment_percent, additional_work, diff_range, key_count, zipf);
+        return 0;
+    }
+    else if (mode == "ids")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        long long max_lease = options.count("max-lease") ? std::stoll(options["max-lease"]) : 4096;
+        std::cout << "Mode:                \tids" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Max lease:           \t" << max_lease << std::endl;
+        run_id_benchmark(thread_count, run_milliseconds, additional_work, max_lease);
+        return 0;
+    }
+    else if (mode == "semaphore")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        long long permits = options.count("permits") ? std::stoll(options["permits"]) : std::max(thread_count / 2, 1);
+        long long k = options.count("k") ? std::stoll(options["k"]) : 1;
+        bool bounded = options.count("bounded") > 0;
+        std::string impl = options.count("impl") ? options["impl"] : "funnel";
+        std::string wait = options.count("wait") ? options["wait"] : "spin";
+        std::cout << "Mode:                \tsemaphore" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Implementation:      \t" << impl << (bounded ? " (bounded)" : "") << std::endl;
+        std::cout << "Wait policy:         \t" << wait << std::endl;
+        std::cout << "Permits / k:         \t" << permits << " / " << k << std::endl;
+        run_semaphore_benchmark(thread_count, run_milliseconds, additional_work, permits, k, bounded, impl, wait);
+        return 0;
+    }
+    else if (mode == "lock")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int read_percent = (argc > 3) ? std::stoi(argv[3]) : 0;
+        int additional_work = (argc > 4) ? std::stoi(argv[4]) : 32;
+        int cs_length = options.count("cs") ? std::stoi(options["cs"]) : 8;
+        std::string lock_type = options.count("lock") ? options["lock"] : "ticket";
+        std::string wait = options.count("wait") ? options["wait"] : "spin";
+        std::cout << "Mode:                \tlock" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Read percent:        \t" << read_percent << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Lock:                \t" << lock_type << std::endl;
+        std::cout << "Wait policy:         \t" << wait << std::endl;
+        std::cout << "Critical section:    \t" << cs_length << std::endl;
+        run_lock_benchmark(thread_count, run_milliseconds, read_percent, additional_work, cs_length, lock_type, wait);
+        return 0;
+    }
+    else if (mode == "barrier")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        std::string impl = options.count("impl") ? options["impl"] : "funnel";
+        std::string wait = options.count("wait") ? options["wait"] : "spin";
+        std::cout << "Mode:                \tbarrier" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Implementation:      \t" << impl << std::endl;
+        std::cout << "Wait policy:         \t" << wait << std::endl;
+        run_barrier_benchmark(thread_count, run_milliseconds, additional_work, impl, wait);
+        return 0;
+    }
+    else if (mode == "refcount")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        int object_count = options.count("objects") ? std::stoi(options["objects"]) : 1;
+        int read_length = options.count("read") ? std::stoi(options["read"]) : 16;
+        std::string impl = options.count("impl") ? options["impl"] : "funnel";
+        std::cout << "Mode:                \trefcount" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Implementation:      \t" << impl << std::endl;
+        std::cout << "Objects:             \t" << object_count << std::endl;
+        std::cout << "Read length:         \t" << read_length << std::endl;
+        run_refcount_benchmark(thread_count, run_milliseconds, additional_work, object_count, read_length, impl);
+        return 0;
+    }
+    else if (mode == "parallel-for")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        long long loop_size = options.count("iterations") ? std::stoll(options["iterations"]) : 1LL << 20;
+        long long min_chunk = options.count("chunk") ? std::stoll(options["chunk"]) : 1;
+        std::string schedule = options.count("schedule") ? options["schedule"] : "guided";
+        std::string workload = options.count("workload") ? options["workload"] : "uniform";
+        std::cout << "Mode:                \tparallel-for" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Iterations per loop: \t" << loop_size << std::endl;
+        std::cout << "Schedule:            \t" << schedule << " (min chunk " << min_chunk << ")" << std::endl;
+        std::cout << "Workload:            \t" << workload << std::endl;
+        run_scheduler_benchmark(thread_count, run_milliseconds, additional_work, loop_size, min_chunk, schedule, workload);
+        return 0;
+    }
+    else if (mode == "log")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        long long record_bytes = options.count("record") ? std::stoll(options["record"]) : 64;
+        long long segment_bytes = options.count("segment") ? std::stoll(options["segment"]) : 1LL << 20;
+        long long segment_count = options.count("segments") ? std::stoll(options["segments"]) : 16;
+        std::cout << "Mode:                \tlog" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Record bytes:        \t" << record_bytes << std::endl;
+        std::cout << "Segments:            \t" << segment_count << " x " << segment_bytes << " bytes" << std::endl;
+        run_log_benchmark(thread_count, run_milliseconds, additional_work, record_bytes, segment_bytes, segment_count);
+        return 0;
+    }
+    else if (mode == "multiprocess")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        int process_count = options.count("processes") ? std::stoi(options["processes"]) : thread_count;
+        int fanout = options.count("fanout") ? std::stoi(options["fanout"]) : 6;
+        std::string impl = options.count("impl") ? options["impl"] : "funnel";
+        std::cout << "Mode:                \tmultiprocess" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Implementation:      \t" << impl << std::endl;
+        std::cout << "Processes:           \t" << process_count << std::endl;
+        std::cout << "Fanout:              \t" << fanout << std::endl;
+        run_multiprocess_benchmark(thread_count, run_milliseconds, additional_work, process_count, fanout, impl);
+        return 0;
+    }
+    else if (mode == "durable")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        long long chunk = options.count("chunk") ? std::stoll(options["chunk"]) : 1024;
+        std::string path = options.count("file") ? options["file"] : "results/durable_counter.dat";
+        std::cout << "Mode:                \tdurable" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Chunk:               \t" << chunk << std::endl;
+        std::cout << "Mark file:           \t" << path << std::endl;
+        run_durable_benchmark(thread_count, run_milliseconds, additional_work, chunk, path);
+        return 0;
+    }
+    else if (mode == "async")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int additional_work = (argc > 3) ? std::stoi(argv[3]) : 32;
+        int task_count = options.count("tasks") ? std::stoi(options["tasks"]) : 4 * thread_count;
+        std::string impl = options.count("impl") ? options["impl"] : "async";
+        std::cout << "Mode:                \tasync" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Implementation:      \t" << impl << std::endl;
+        std::cout << "Tasks:               \t" << task_count << std::endl;
+        run_async_benchmark(thread_count, run_milliseconds, additional_work, task_count, impl);
+        return 0;
+    }
+    else if (mode == "attach")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int read_percent = (argc > 3) ? std::stoi(argv[3]) : 50;
+        int additional_work = (argc > 4) ? std::stoi(argv[4]) : 32;
+        long long diff_range = (argc > 5) ? std::stoll(argv[5]) : 100LL;
+        int direct_count = options.count("direct") ? std::stoi(options["direct"]) : thread_count / 2;
+        std::cout << "Mode:                \tattach" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Read percent:        \t" << read_percent << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Diff range:          \t" << diff_range << std::endl;
+        std::cout << "Direct writers:      \t" << direct_count << std::endl;
+        run_attach_benchmark(thread_count, run_milliseconds, read_percent, additional_work, diff_range, direct_count);
+        return 0;
+    }
+    else if (mode == "sharded")
+    {
+        int thread_count = std::stoi(argv[1]);
+        int run_milliseconds = std::stoi(argv[2]);
+        int read_percent = (argc > 3) ? std::stoi(argv[3]) : 50;
+        int additional_work = (argc > 4) ? std::stoi(argv[4]) : 32;
+        long long diff_range = (argc > 5) ? std::stoll(argv[5]) : 100LL;
+        std::string impl = options.count("impl") ? options["impl"] : "sharded";
+        std::string read = options.count("read") ? options["read"] : "snapshot";
+        std::cout << "Mode:                \tsharded" << std::endl;
+        std::cout << "Thread count:        \t" << thread_count << std::endl;
+        std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
+        std::cout << "Read percent:        \t" << read_percent << std::endl;
+        std::cout << "Additional work:     \t" << additional_work << std::endl;
+        std::cout << "Diff range:          \t" << diff_range << std::endl;
+        std::cout << "Implementation:      \t" << impl << std::endl;
+        std::cout << "Read:                \t" << read << std::endl;
+        run_sharded_benchmark(thread_count, run_milliseconds, read_percent, additional_work, diff_range, impl, read);
+        return 0;
+    }
+    else if (mode != "counter")
+    {
+        std::cout << "Unknown mode: " << mode << std::endl;
         return 1;
     }
     assert(argc > 2);
@@ -203,6 +532,15 @@ int main(int argc, char const *argv[])
     int increment_percent = (argc > ++arg_pos) ? std::stoi(argv[arg_pos]) : 100 - read_percent;
     int additional_work = (argc > ++arg_pos) ? std::stoi(argv[arg_pos]) : 32;
     long long diff_range = (argc > ++arg_pos) ? std::stoll(argv[arg_pos]) : 100LL;
+    long long deadline_ns = (argc > ++arg_pos) ? std::stoll(argv[arg_pos]) : 0LL; // 0: plain fetch_add
+    bool balanced = options.count("balanced") > 0; // needs a counter that takes negative diffs
+    int latency_steps = options.count("latency") ? std::stoi(options["latency"]) : LATENCY_SAMPLE_STEPS;
+    std::string pin = options.count("pin") ? options["pin"] : "none";
+    if (!THREAD_PLACEMENT::is_policy(pin))
+    {
+        std::cout << "Unknown pin policy: " << pin << std::endl;
+        return 1;
+    }
 
     std::cout << "Thread count:        \t" << thread_count << std::endl;
     std::cout << "Run milliseconds:    \t" << run_milliseconds << std::endl;
@@ -211,10 +549,15 @@ int main(int argc, char const *argv[])
     std::cout << "Additional work:     \t" << additional_work << std::endl;
     std::cout << "Diff range:          \t" << diff_range
               << std::endl;
+    std::cout << "Deadline (ns):       \t" << deadline_ns << std::endl;
+    std::cout << "Balanced +/-:        \t" << balanced << std::endl;
+    std::cout << "Latency sample steps:\t" << latency_steps << std::endl;
+    std::cout << "Pin policy:          \t" << pin << std::endl;
 
     Timer timer;
-    auto [max_access, root_access, results] = run_benchmark(
-        timer, thread_count, run_milliseconds, read_percent, increment_percent, additional_work, diff_range);
+    auto [max_access, root_access, results, latencies, cpus] = run_benchmark(
+        timer, thread_count, run_milliseconds, read_percent, increment_percent, additional_work, diff_range, deadline_ns, balanced, latency_steps,
+        THREAD_PLACEMENT::plan_placement(pin, thread_count));
     double ms = timer.elapsed();
 
     std::cout << " --- Benchmark results --- " << std::endl;
@@ -223,11 +566,14 @@ int main(int argc, char const *argv[])
     std::cout << "Operation counts: " << std::endl;
     long long total_count = 0;
     long long total_update_count = 0;
+    long long total_timeout_count = 0, total_fallback_count = 0;
     long long max_throughput = 0, min_throughput = 2e18;
     for (int i = 0; i < thread_count; i++)
     {
         total_count += results[i].total_count;
         total_update_count += results[i].op_counts[1];
+        total_timeout_count += results[i].timeout_count;
+        total_fallback_count += results[i].fallback_count;
         max_throughput = std::max(max_throughput, results[i].total_count);
         min_throughput = std::min(min_throughput, results[i].total_count);
         std::cerr << "Thread " << i << " : " << results[i].op_counts[0] << " " << results[i].op_counts[1] << " : " << results[i].total_count << " ___ " << results[i].random_work << std::endl;
@@ -250,23 +596,70 @@ int main(int argc, char const *argv[])
     std::cout << "Root access ratio: " << (double)root_access / total_update_count << std::endl;
     std::cout << "Max access ratio : " << (double)max_access / total_update_count << std::endl;
 
+    if (deadline_ns > 0)
+    {
+        std::cout << "Timeout ratio : " << (double)total_timeout_count / total_update_count << std::endl;
+        std::cout << "Fallback ratio: " << (double)total_fallback_count / total_update_count << std::endl;
+    }
+
+    // p50, p90, p99, p99.9 and max in ns
+    const double quantiles[5] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    auto latency_ns = [&](const LatencyHistogram &histogram, int q) -> long long
+    {
+        return (long long)(histogram.value_at(quantiles[q]) * latencies.ns_per_tick);
+    };
+    const LatencyHistogram *histograms[4] = {&latencies.read, &latencies.increment, &latencies.delegate, &latencies.waiter};
+    auto print_latency = [&](const std::string &name, const LatencyHistogram &histogram)
+    {
+        std::cout << name << " latency (ns) p50 / p90 / p99 / p99.9 / max: ";
+        for (int q = 0; q < 5; q++)
+            std::cout << latency_ns(histogram, q) << (q < 4 ? " / " : "");
+        std::cout << " (" << histogram.count() << " samples)" << std::endl;
+    };
+    if (latency_steps > 0)
+    {
+        print_latency("Read     ", latencies.read);
+        print_latency("Increment", latencies.increment);
+#if defined(AUX_DATA) && AUX_DATA != 0
+        print_latency("Delegate ", latencies.delegate);
+        print_latency("Waiter   ", latencies.waiter);
+#else
+        std::cout << "Delegate / waiter split needs AUX_DATA=1" << std::endl;
+#endif
+    }
+
     // write main data
     std::cout << "Writing to results_counter.csv" << std::endl;
     std::ofstream summary_file("results/counter_main.csv");
-    summary_file << "thread_count,run_milliseconds,read_percent,increment_percent,additional_work,total_count,elapsed_time,max_access_ratio,root_access_ratio,fairness,stddev,throughput" << std::endl;
+    summary_file << "thread_count,run_milliseconds,read_percent,increment_percent,additional_work,total_count,elapsed_time,max_access_ratio,root_access_ratio,fairness,stddev,throughput,deadline_ns,timeout_ratio,fallback_ratio,balanced,latency_steps,pin";
+    for (std::string kind : {"read", "increment", "delegate", "waiter"})
+        summary_file << "," << kind << "_latency_p50," << kind << "_latency_p90," << kind << "_latency_p99," << kind << "_latency_p999," << kind << "_latency_max";
+    summary_file << std::endl;
     summary_file << thread_count << "," << run_milliseconds << "," << read_percent << "," << increment_percent << "," << additional_work;
-    summary_file << "," << total_count << "," << ms << "," << (double)max_access / total_update_count << "," << (double)root_access / total_update_count << "," << (double)min_throughput / max_throughput << "," << std_dev << "," << (double)total_count / timer.elapsed() << std::endl;
+    summary_file << "," << total_count << "," << ms << "," << (double)max_access / total_update_count << "," << (double)root_access / total_update_count << "," << (double)min_throughput / max_throughput << "," << std_dev << "," << (double)total_count / timer.elapsed();
+    summary_file << "," << deadline_ns << "," << (double)total_timeout_count / total_update_count << "," << (double)total_fallback_count / total_update_count;
+    summary_file << "," << balanced << "," << latency_steps << "," << pin;
+    // Histograms without samples (latency off, or the split without
+    // AUX_DATA) leave their columns empty
+    for (const LatencyHistogram *histogram : histograms)
+        for (int q = 0; q < 5; q++)
+        {
+            summary_file << ",";
+            if (histogram->count() > 0)
+                summary_file << latency_ns(*histogram, q);
+        }
+    summary_file << std::endl;
     summary_file.close();
 
     // write aux data
     std::cout << "Writing to results_aux.csv" << std::endl;
     std::ofstream aux_file("results/counter_aux.csv");
-    aux_file << "thread_id,read_count,inc_count,total_count,loop_count_1,loop_count_2,root_access" << std::endl;
+    aux_file << "thread_id,read_count,inc_count,total_count,loop_count_1,loop_count_2,root_access,timeout_count,fallback_count,cpu" << std::endl;
     for (int i = 0; i < thread_count; i++)
     {
-        // i, read_count, inc_count, total_count, loop_count_1, loop_count_2, root_access
+        // i, read_count, inc_count, total_count, loop_count_1, loop_count_2, root_access, timeout_count, fallback_count, cpu
         RunResult &res = results[i];
-        aux_file << i << "," << res.op_counts[0] << "," << res.op_counts[1] << "," << res.total_count << "," << res.loop_count_1 << "," << res.loop_count_2 << "," << res.root_access << std::endl;
+        aux_file << i << "," << res.op_counts[0] << "," << res.op_counts[1] << "," << res.total_count << "," << res.loop_count_1 << "," << res.loop_count_2 << "," << res.root_access << "," << res.timeout_count << "," << res.fallback_count << "," << cpus[i] << std::endl;
     }
     aux_file.close();
 
@@ -1,3 +1,4 @@
+#pragma once
 
 #include <atomic>
 #include <iostream>
@@ -14,8 +15,12 @@
 #include <queue>
 #include <iomanip>
 #include <sstream>
+#include <memory>
+#include <cmath>
+#include <algorithm>
 
 #include "../structures/counter/targetCounter.hpp"
+#include "../structures/sync/funnelBarrier.hpp"
 
 int get_thread_id()
 {
@@ -41,6 +46,61 @@ std::mt19937 get_mt_generator(int seed)
     return std::mt19937(seed);
 }
 
+typedef std::tuple<int, long long> CounterOperation;
+class CounterOperationGenerator
+{
+private:
+    int seed;
+    static const int OP_TYPES = 2;
+
+    int ratios_sum[OP_TYPES] = {100, 0}; // read, increment
+    long long diff_range;
+    bool balanced; // increments are +diff or -diff with equal odds
+    std::mt19937 mtg;
+
+public:
+    CounterOperationGenerator(int seed, const int ratios[], long long diff_range, bool balanced = false)
+    {
+        this->seed = seed;
+        this->diff_range = diff_range;
+        this->balanced = balanced;
+
+        ratios_sum[0] = ratios[0];
+        for (int i = 1; i < OP_TYPES; i++)
+            ratios_sum[i] = ratios_sum[i - 1] + ratios[i];
+        mtg = std::mt19937(seed);
+    }
+
+    CounterOperation next()
+    {
+        int op_rd = mtg() % 100;
+        int op = -1;
+        for (int i = 0; i < OP_TYPES; i++)
+        {
+            if (op_rd < ratios_sum[i])
+            {
+                op = i;
+                break;
+            }
+        }
+
+        if (op == 0) // read
+        {
+            return CounterOperation(0, -1);
+        }
+        else if (op == 1) // insert
+        {
+            long long diff = (((1LL * mtg()) << 30) + mtg()) % diff_range + 1;
+            // int diff = 1;
+            if (balanced && mtg() % 2)
+                diff = -diff;
+            return CounterOperation(1, diff);
+        }
+        else
+            throw std::runtime_error("Invalid operation");
+    }
+};
+
 typedef std::tuple<int, int, int> TestOperation;
 class OperationGenerator
 {
@@ -129,6 +189,11 @@ public:
     }
 };
 
+// Start barrier of the benchmark runs. Its arrivals are a plain hardware
+// fetch_add, so the counter under test is the only funnel in the run.
+typedef FUNNEL_BARRIER::FunnelBarrier<HARDWARE_ATOMIC::HardwareCounter<long long>> HarnessBarrier;
+
+// Single-use barrier the harness started with, kept for --mode=barrier
 class MemoryBarrier
 {
 public:
@@ -190,3 +255,34 @@ public:
         return std::chrono::duration_cast<std::chrono::milliseconds>(end_ts - start_ts).count();
     }
 };
+
+// Keys in [0, key_count) with P(k) proportional to 1 / (k + 1)^exponent;
+// exponent 0 is uniform. The CDF is shared, so copies are cheap per thread.
+class ZipfGenerator
+{
+private:
+    std::shared_ptr<std::vector<double>> cdf;
+    std::mt19937 mtg;
+    std::uniform_real_distribution<double> unit;
+
+public:
+    ZipfGenerator(int key_count, double exponent, int seed) : mtg(seed), unit(0.0, 1.0)
+    {
+        cdf = std::make_shared<std::vector<double>>(key_count);
+        double sum = 0;
+        for (int k = 0; k < key_count; k++)
+        {
+            sum += 1.0 / std::pow(k + 1.0, exponent);
+            (*cdf)[k] = sum;
+        }
+        for (auto &c : *cdf)
+            c /= sum;
+    }
+    ZipfGenerator(const ZipfGenerator &other, int seed) : cdf(other.cdf), mtg(seed), unit(0.0, 1.0) {}
+
+    int next()
+    {
+        int k = std::lower_bound(cdf->begin(), cdf->end(), unit(mtg)) - cdf->begin();
+        return std::min(k, (int)cdf->size() - 1);
+    }
+};
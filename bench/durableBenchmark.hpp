@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+#include <cstdio>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/durable/durableCounter.hpp"
+
+// Every thread draws sequence numbers from one durable TargetCounter
+// (--mode=durable), which msyncs its mark file once per chunk of values. With
+// --chunk=1 on the hardwareCounter target, every fetch_add is synced on its own.
+// The file is recreated each run, then reopened to check recovery.
+void run_durable_benchmark(int thread_count, int run_milliseconds, int additional_work, long long chunk, std::string path)
+{
+    std::remove(path.c_str());
+    DURABLE_COUNTER::DurableCounter<TargetCounter> *counter = new DURABLE_COUNTER::DurableCounter<TargetCounter>(path, chunk, thread_count);
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    RunResult results[thread_count];
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        // op_counts[1] are sequence numbers drawn
+        auto thread_func = [&](int id)
+        {
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                counter->fetch_add(1, id);
+                result.op_counts[1]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    long long total_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        std::cerr << "Thread " << i << " : " << results[i].total_count << " numbers ___ " << results[i].random_work << std::endl;
+    }
+    long long msyncs = counter->msyncs();
+    long long mark = counter->persisted_mark();
+    if (counter->load() != total_count || mark < total_count)
+        throw std::runtime_error("Durable counter lost increments");
+    delete counter;
+
+    DURABLE_COUNTER::DurableCounter<TargetCounter> reopened(path, chunk, 1);
+    if (reopened.recovered_from() != mark)
+        throw std::runtime_error("Durable counter did not recover its mark");
+    std::remove(path.c_str());
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " numbers/ms" << std::endl;
+    std::cout << "Msyncs: " << msyncs << " (" << std::fixed << std::setprecision(2) << (double)total_count / std::max(msyncs, 1LL) << " numbers each)" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,chunk,total_count,msync_count,persisted_mark,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << chunk;
+    summary_file << "," << total_count << "," << msyncs << "," << mark << "," << ms << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,number_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
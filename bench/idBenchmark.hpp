@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/allocator/rangeIdAllocator.hpp"
+
+typedef RANGE_ID_ALLOCATOR::RangeIdAllocator<TargetCounter> TargetIdAllocator;
+
+// Every thread takes IDs back to back (--mode=ids). --max-lease=1 is the plain
+// fetch_add(1) per ID service. At the end the leases are released and the IDs
+// handed out plus the unused ones must add up to the counter.
+void run_id_benchmark(int thread_count, int run_milliseconds, int additional_work, long long max_lease)
+{
+    TargetIdAllocator *allocator = new TargetIdAllocator(thread_count, max_lease);
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    RunResult results[thread_count];
+    long long lease_sizes[thread_count];
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        // op_counts[1] are IDs, root_access are refills
+        auto thread_func = [&](int id)
+        {
+            RANGE_ID_ALLOCATOR::ThreadLease<TargetIdAllocator> lease(allocator, id);
+            long long last = -1;
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                long long next = lease.next_id();
+                if (next <= last)
+                    throw std::runtime_error("IDs of one thread must increase");
+                last = next;
+                result.op_counts[1]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            result.root_access = allocator->refill_count(id);
+            lease_sizes[id] = allocator->lease_size(id);
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    long long total_count = 0, total_refills = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        total_refills += results[i].root_access;
+        std::cerr << "Thread " << i << " : " << results[i].total_count << " ids, " << results[i].root_access << " leases, last lease " << lease_sizes[i] << " ___ " << results[i].random_work << std::endl;
+    }
+    std::cout << "IDs + unused : " << total_count + allocator->unused() << std::endl;
+    std::cout << "High water   : " << allocator->high_water() << std::endl;
+    delete allocator;
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " ids/ms" << std::endl;
+    std::cout << "Leases per ID: " << (double)total_refills / total_count << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,max_lease,total_count,elapsed_time,lease_ratio,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << max_lease;
+    summary_file << "," << total_count << "," << ms << "," << (double)total_refills / total_count << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,id_count,lease_count,last_lease_size" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].total_count << "," << results[i].root_access << "," << lease_sizes[i] << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/counter/keyedAggregatingFunnel.hpp"
+
+// The keyed mode pairs with the counter target: hardwareCounter builds the
+// one-atomic-per-key baseline, any other target the shared-aggregator funnel
+// with that target's stump flags (AGG_COUNT, DIRECT_COUNT, USE_ROOT_AGGS)
+#ifdef USE_HARDWARE_COUNTER
+typedef HARDWARE_ATOMIC::KeyedHardwareCounter<long long> TargetKeyedCounter;
+#else
+typedef KEYED_AGG_FUNNEL::KeyedAggFunnel<long long> TargetKeyedCounter;
+#endif
+
+// Same read/increment mix as the counter mode (--mode=keyed), with every
+// operation on a key drawn uniformly or from a Zipf distribution
+void run_keyed_benchmark(int thread_count, int run_milliseconds, int read_percent, int increment_percent, int additional_work, long long diff_range, int key_count, double zipf)
+{
+    TargetKeyedCounter *counter = new TargetKeyedCounter(key_count, thread_count);
+    const int ratios[2] = {read_percent, increment_percent};
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+    ZipfGenerator key_dist(key_count, zipf, core_seed);
+
+    std::atomic<long long> mirror_counter(0);
+    RunResult results[thread_count];
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        auto thread_func = [&](int id)
+        {
+            auto seed = core_seed * 1000 + id;
+            auto gen = CounterOperationGenerator(seed, ratios, diff_range);
+            ZipfGenerator keys(key_dist, seed);
+            long long count = 0;
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(seed);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                auto op = gen.next();
+                int key = keys.next();
+                if (std::get<0>(op) == 0)
+                { // read
+                    rd_work += counter->load(key);
+                }
+                else
+                { // increment
+                    long long diff = std::get<1>(op);
+                    rd_work += counter->fetch_add(key, diff, id);
+                    count += diff;
+                }
+                result.op_counts[std::get<0>(op)]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            mirror_counter.fetch_add(count);
+            result.random_work = rd_work;
+#if defined(AUX_DATA) && AUX_DATA != 0
+            counter->update_aux_data(id, result);
+#endif
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    long long sum = 0;
+    for (int k = 0; k < key_count; k++)
+        sum += counter->load(k);
+    std::cout << "Structure gave : " << sum << std::endl;
+    std::cout << "Verification gave : " << mirror_counter.load() << std::endl;
+
+#if defined(AUX_DATA) && AUX_DATA != 0
+    long long root_access = counter->root_access();
+#else
+    long long root_access = 0;
+#endif
+    delete counter;
+
+    long long total_count = 0, total_update_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        total_update_count += results[i].op_counts[1];
+        std::cerr << "Thread " << i << " : " << results[i].op_counts[0] << " " << results[i].op_counts[1] << " : " << results[i].total_count << " ___ " << results[i].random_work << std::endl;
+    }
+    double ms = timer.elapsed();
+
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " ops/ms" << std::endl;
+    std::cout << "Root access ratio: " << (double)root_access / total_update_count << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,read_percent,increment_percent,additional_work,key_count,zipf,total_count,elapsed_time,root_access_ratio,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << read_percent << "," << increment_percent << "," << additional_work << "," << key_count << "," << zipf;
+    summary_file << "," << total_count << "," << ms << "," << (double)root_access / total_update_count << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,read_count,inc_count,total_count,loop_count_1,loop_count_2,root_access" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+    {
+        RunResult &res = results[i];
+        aux_file << i << "," << res.op_counts[0] << "," << res.op_counts[1] << "," << res.total_count << "," << res.loop_count_1 << "," << res.loop_count_2 << "," << res.root_access << std::endl;
+    }
+    aux_file.close();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <x86intrin.h>
+
+// Time stamp counter read for latency samples; the lfence keeps it from
+// moving ahead of the preceding operation
+inline unsigned long long read_tsc()
+{
+    _mm_lfence();
+    return __rdtsc();
+}
+
+// Log-bucketed latency histogram in the style of HdrHistogram. Values below
+// 2^SUB_BITS have a bucket each; above that every power of two is split into
+// 2^(SUB_BITS - 1) buckets, so a reported value is at most 1/16 above the
+// recorded one. Recording is an index computation and an increment, so each
+// thread keeps its own and they are merged after the run.
+class LatencyHistogram
+{
+private:
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int HALF_COUNT = SUB_COUNT / 2;
+    static const int BUCKET_COUNT = SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT;
+
+    std::vector<long long> counts;
+    long long total = 0;
+    unsigned long long max_value = 0;
+
+    static int bucket_of(unsigned long long value)
+    {
+        if (value < SUB_COUNT)
+            return value;
+        int shift = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+        return SUB_COUNT + (shift - 1) * HALF_COUNT + (int)(value >> shift) - HALF_COUNT;
+    }
+
+    // Largest value that falls into the bucket
+    static unsigned long long bucket_top(int bucket)
+    {
+        if (bucket < SUB_COUNT)
+            return bucket;
+        int shift = (bucket - SUB_COUNT) / HALF_COUNT + 1;
+        unsigned long long sub = (bucket - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() : counts(BUCKET_COUNT, 0) {}
+
+    void record(unsigned long long value)
+    {
+        counts[bucket_of(value)]++;
+        total++;
+        max_value = std::max(max_value, value);
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < BUCKET_COUNT; i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    long long count() const
+    {
+        return total;
+    }
+
+    // Smallest value v with at least quantile * count() samples <= v, up to
+    // the bucket precision; 0 when empty
+    unsigned long long value_at(double quantile) const
+    {
+        if (total == 0)
+            return 0;
+        long long rank = std::max(1LL, std::min(total, (long long)(quantile * total + 0.999999)));
+        long long seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(bucket_top(i), max_value);
+        }
+        return max_value;
+    }
+};
+
+// Converts time stamp counter ticks to nanoseconds, calibrated against the
+// steady clock over the run
+class TscCalibration
+{
+private:
+    unsigned long long start_tsc = 0, stop_tsc = 0;
+    std::chrono::steady_clock::time_point start_ts, stop_ts;
+
+public:
+    void start()
+    {
+        start_ts = std::chrono::steady_clock::now();
+        start_tsc = read_tsc();
+    }
+
+    void stop()
+    {
+        stop_ts = std::chrono::steady_clock::now();
+        stop_tsc = read_tsc();
+    }
+
+    double ns_per_tick() const
+    {
+        if (stop_tsc <= start_tsc)
+            return 0;
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop_ts - start_ts).count() / (stop_tsc - start_tsc);
+    }
+};
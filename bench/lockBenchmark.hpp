@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/common.hpp"
+#include "../structures/sync/funnelLocks.hpp"
+
+// my_mutex behind the lock interface of funnelLocks.hpp
+class TtasLock
+{
+    my_mutex mtx;
+
+public:
+    TtasLock(int thread_count) {}
+    void lock(int thread_id) { mtx.lock(); }
+    void unlock(int thread_id) { mtx.unlock(); }
+};
+
+// Readers of a lock without a shared mode take it exclusively
+template <typename Lock>
+class ExclusiveOnly : public Lock
+{
+public:
+    ExclusiveOnly(int thread_count) : Lock(thread_count) {}
+    void lock_shared(int thread_id) { this->lock(thread_id); }
+    void unlock_shared(int thread_id) { this->unlock(thread_id); }
+};
+
+// Every thread takes the lock shared (read_percent of the time) or exclusively,
+// runs a critical section of cs_length steps over a small shared array, and
+// does its additional work outside (--mode=lock). Writers bump every cell,
+// readers check that all cells agree, so a broken lock shows up as an error.
+template <typename Lock>
+void lock_benchmark_loop(int thread_count, int run_milliseconds, int read_percent, int additional_work, int cs_length, RunResult results[], Timer &timer)
+{
+    static const int CELLS = 8;
+    Lock *lock = new Lock(thread_count);
+    alignas(64) volatile long long cells[CELLS] = {};
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        // op_counts[0] are shared acquisitions, op_counts[1] exclusive ones
+        auto thread_func = [&](int id)
+        {
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                if ((int)(rd_gen() % 100) < read_percent)
+                {
+                    lock->lock_shared(id);
+                    for (int i = 0; i < cs_length; i++)
+                        if (cells[i % CELLS] != cells[0])
+                            throw std::runtime_error("Reader saw a writer inside the critical section");
+                    lock->unlock_shared(id);
+                    result.op_counts[0]++;
+                }
+                else
+                {
+                    lock->lock(id);
+                    long long next = cells[0] + 1;
+                    for (int i = 0; i < cs_length; i++)
+                        cells[i % CELLS] = next;
+                    for (int i = cs_length; i < CELLS; i++)
+                        cells[i] = next;
+                    lock->unlock(id);
+                    result.op_counts[1]++;
+                }
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    long long writes = 0;
+    for (int i = 0; i < thread_count; i++)
+        writes += results[i].op_counts[1];
+    if (cells[0] != writes)
+        throw std::runtime_error("Lost writes: " + std::to_string(cells[0]) + " != " + std::to_string(writes));
+    delete lock;
+}
+
+// --lock=ticket and --lock=rw take their tickets from TargetCounter, so the
+// hardwareCounter target is the plain fetch_add baseline; --lock=ttas is my_mutex
+void run_lock_benchmark(int thread_count, int run_milliseconds, int read_percent, int additional_work, int cs_length, std::string lock_type, std::string wait)
+{
+    using namespace FUNNEL_LOCKS;
+    using Spin = WAIT_POLICY::SpinWait;
+    using Park = WAIT_POLICY::ParkWait;
+    RunResult results[thread_count];
+    Timer timer;
+    if (lock_type == "ttas")
+        lock_benchmark_loop<ExclusiveOnly<TtasLock>>(thread_count, run_milliseconds, read_percent, additional_work, cs_length, results, timer);
+    else if (lock_type == "ticket" && wait == "park")
+        lock_benchmark_loop<ExclusiveOnly<TicketLock<TargetCounter, Park>>>(thread_count, run_milliseconds, read_percent, additional_work, cs_length, results, timer);
+    else if (lock_type == "ticket")
+        lock_benchmark_loop<ExclusiveOnly<TicketLock<TargetCounter, Spin>>>(thread_count, run_milliseconds, read_percent, additional_work, cs_length, results, timer);
+    else if (lock_type == "rw" && wait == "park")
+        lock_benchmark_loop<PhaseFairRWLock<TargetCounter, Park>>(thread_count, run_milliseconds, read_percent, additional_work, cs_length, results, timer);
+    else if (lock_type == "rw")
+        lock_benchmark_loop<PhaseFairRWLock<TargetCounter, Spin>>(thread_count, run_milliseconds, read_percent, additional_work, cs_length, results, timer);
+    else
+        throw std::runtime_error("Unknown lock: " + lock_type);
+
+    long long read_count = 0, write_count = 0, min_count = -1, max_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        read_count += results[i].op_counts[0];
+        write_count += results[i].op_counts[1];
+        min_count = (min_count < 0 || results[i].total_count < min_count) ? results[i].total_count : min_count;
+        max_count = std::max(max_count, results[i].total_count);
+        std::cerr << "Thread " << i << " : " << results[i].op_counts[0] << " reads, " << results[i].op_counts[1] << " writes ___ " << results[i].random_work << std::endl;
+    }
+    double ms = timer.elapsed();
+    // FIFO locks keep this close to 1, a TTAS lock lets some threads starve
+    double fairness = max_count > 0 ? (double)min_count / max_count : 0;
+
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Read throughput: " << std::fixed << std::setprecision(2) << read_count / ms << " ops/ms" << std::endl;
+    std::cout << "Write throughput: " << std::fixed << std::setprecision(2) << write_count / ms << " ops/ms" << std::endl;
+    std::cout << "Fairness (min/max): " << std::fixed << std::setprecision(3) << fairness << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,read_percent,additional_work,cs_length,lock,wait,total_count,elapsed_time,read_throughput,write_throughput,fairness,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << read_percent << "," << additional_work << "," << cs_length << "," << lock_type << "," << wait;
+    summary_file << "," << read_count + write_count << "," << ms << "," << read_count / ms << "," << write_count / ms << "," << fairness << "," << (read_count + write_count) / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,read_count,write_count,total_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].op_counts[0] << "," << results[i].op_counts[1] << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/log/appendLog.hpp"
+
+typedef APPEND_LOG::AppendLog<TargetCounter, WAIT_POLICY::ParkWait> TargetLog;
+
+// Every thread appends record_bytes records back to back (--mode=log) while an
+// extra reader thread consumes the committed prefix and recycles segments.
+// Writers stall when the reader falls a whole ring behind, so the segment
+// count sets how much slack the writers get.
+void run_log_benchmark(int thread_count, int run_milliseconds, int additional_work, long long record_bytes, long long segment_bytes, long long segment_count)
+{
+    TargetLog *log = new TargetLog(segment_bytes, segment_count, thread_count);
+    if (record_bytes > log->max_payload())
+        throw std::runtime_error("--record must fit in a segment");
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    RunResult results[thread_count];
+    long long consumed = 0;
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+        std::atomic<bool> writers_done(false);
+
+        // op_counts[1] are appended records
+        auto thread_func = [&](int id)
+        {
+            std::vector<char> record(record_bytes, (char)id);
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                log->append(record.data(), record_bytes, id);
+                result.op_counts[1]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+        };
+
+        std::thread reader([&]()
+                           {
+            long long sink = 0;
+            auto touch = [&](const char *payload, long long bytes, long long offset)
+            { sink += payload[0]; };
+            while (!writers_done.load())
+            {
+                long long n = log->consume(touch);
+                consumed += n;
+                if (n == 0)
+                    std::this_thread::yield();
+            }
+            consumed += log->consume(touch); });
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+        writers_done.store(true);
+        reader.join();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    long long total_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        std::cerr << "Thread " << i << " : " << results[i].total_count << " records ___ " << results[i].random_work << std::endl;
+    }
+    long long reserved = log->reserved();
+    if (log->committed_prefix() != reserved || consumed != total_count)
+        throw std::runtime_error("Reader stopped short of the tail");
+    delete log;
+
+    double ms = timer.elapsed();
+    double megabytes = (double)total_count * record_bytes / 1e6;
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " records/ms" << std::endl;
+    std::cout << "Payload bandwidth: " << std::fixed << std::setprecision(2) << megabytes / ms * 1000 << " MB/s" << std::endl;
+    std::cout << "Log bytes per record: " << std::fixed << std::setprecision(2) << (double)reserved / std::max(total_count, 1LL) << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,record_bytes,segment_bytes,segment_count,total_count,reserved_bytes,elapsed_time,bandwidth,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << record_bytes << "," << segment_bytes << "," << segment_count;
+    summary_file << "," << total_count << "," << reserved << "," << ms << "," << megabytes / ms * 1000 << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,record_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
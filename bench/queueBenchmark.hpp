@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/queue/funnelRingQueue.hpp"
+
+typedef FUNNEL_RING_QUEUE::RingQueue<long long, TargetCounter> TargetQueue;
+
+// One out of every this many queue operations has its latency recorded
+static const int QUEUE_LATENCY_SAMPLE_STEPS = 16;
+
+// Producer/consumer run of RingQueue<long long, TargetCounter> (--mode=queue).
+// Even thread ids enqueue and odd ones dequeue; a single thread alternates.
+// Only operations finished before the stop signal are counted. Afterwards the
+// main thread, as thread id thread_count, enqueues one poison value per consumer
+// so that consumers blocked on an empty queue can leave, and the sums of all
+// enqueued and dequeued values are compared.
+void run_queue_benchmark(int thread_count, int run_milliseconds, int additional_work, long long capacity)
+{
+    TargetQueue *queue = new TargetQueue(capacity, thread_count + 1);
+    const long long POISON = -1;
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    std::atomic<long long> enqueued_sum(0), dequeued_sum(0);
+    RunResult results[thread_count];
+    std::vector<long long> enq_latencies[thread_count], deq_latencies[thread_count];
+    int consumer_count = 0;
+    for (int i = 0; i < thread_count; i++)
+        consumer_count += (i % 2 == 1);
+
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        // op_counts[0] are dequeues, op_counts[1] are enqueues
+        auto thread_func = [&](int id)
+        {
+            bool producer = (id % 2 == 0);
+            bool consumer = (id % 2 == 1) || thread_count == 1;
+            long long next_value = (long long)id << 40;
+            long long my_enqueued = 0, my_dequeued = 0;
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            std::vector<long long> enq_latency, deq_latency;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                if (producer)
+                {
+                    bool sample = result.op_counts[1] % QUEUE_LATENCY_SAMPLE_STEPS == 0;
+                    auto begin = std::chrono::steady_clock::now();
+                    queue->enqueue(next_value, id);
+                    if (sample)
+                        enq_latency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+                    my_enqueued += next_value++;
+                    result.op_counts[1]++;
+                    result.total_count++;
+                }
+                if (consumer)
+                {
+                    bool sample = result.op_counts[0] % QUEUE_LATENCY_SAMPLE_STEPS == 0;
+                    auto begin = std::chrono::steady_clock::now();
+                    long long value = queue->dequeue(id);
+                    if (value == POISON)
+                        break;
+                    if (sample)
+                        deq_latency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+                    my_dequeued += value;
+                    result.op_counts[0]++;
+                    result.total_count++;
+                }
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+
+            // Drain until the poison value, without counting
+            if (consumer && thread_count > 1)
+            {
+                long long value = queue->dequeue(id);
+                while (value != POISON)
+                {
+                    my_dequeued += value;
+                    value = queue->dequeue(id);
+                }
+            }
+            enqueued_sum.fetch_add(my_enqueued);
+            dequeued_sum.fetch_add(my_dequeued);
+            result.random_work = rd_work;
+            results[id] = result;
+            enq_latencies[id] = std::move(enq_latency);
+            deq_latencies[id] = std::move(deq_latency);
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        timer.stop();
+
+        for (int i = 0; i < thread_count; i += 2)
+            threads[i].join();
+        if (thread_count > 1)
+            for (int i = 0; i < consumer_count; i++)
+                queue->enqueue(POISON, thread_count);
+        for (int i = 1; i < thread_count; i += 2)
+            threads[i].join();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    std::cout << "Enqueued sum : " << enqueued_sum.load() << std::endl;
+    std::cout << "Dequeued sum : " << dequeued_sum.load() << std::endl;
+    std::cout << "Left in queue: " << queue->size() << std::endl;
+    delete queue;
+
+    std::vector<long long> enq_lat, deq_lat;
+    long long enq_count = 0, deq_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        enq_count += results[i].op_counts[1];
+        deq_count += results[i].op_counts[0];
+        enq_lat.insert(enq_lat.end(), enq_latencies[i].begin(), enq_latencies[i].end());
+        deq_lat.insert(deq_lat.end(), deq_latencies[i].begin(), deq_latencies[i].end());
+        std::cerr << "Thread " << i << " : " << results[i].op_counts[0] << " " << results[i].op_counts[1] << " : " << results[i].total_count << " ___ " << results[i].random_work << std::endl;
+    }
+    std::sort(enq_lat.begin(), enq_lat.end());
+    std::sort(deq_lat.begin(), deq_lat.end());
+    auto latency_at = [](const std::vector<long long> &lat, double q) -> long long
+    {
+        if (lat.empty())
+            return 0;
+        return lat[std::min(lat.size() - 1, (size_t)(q * lat.size()))];
+    };
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Enqueue throughput: " << std::fixed << std::setprecision(2) << enq_count / ms << " ops/ms" << std::endl;
+    std::cout << "Dequeue throughput: " << std::fixed << std::setprecision(2) << deq_count / ms << " ops/ms" << std::endl;
+    std::cout << "Enqueue latency (ns) p50 / p99 / p99.9 / max: " << latency_at(enq_lat, 0.5) << " / " << latency_at(enq_lat, 0.99) << " / " << latency_at(enq_lat, 0.999) << " / " << latency_at(enq_lat, 1.0) << std::endl;
+    std::cout << "Dequeue latency (ns) p50 / p99 / p99.9 / max: " << latency_at(deq_lat, 0.5) << " / " << latency_at(deq_lat, 0.99) << " / " << latency_at(deq_lat, 0.999) << " / " << latency_at(deq_lat, 1.0) << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,capacity,additional_work,total_count,elapsed_time,throughput,enq_throughput,deq_throughput,enq_latency_p50,enq_latency_p99,enq_latency_p999,enq_latency_max,deq_latency_p50,deq_latency_p99,deq_latency_p999,deq_latency_max" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << capacity << "," << additional_work;
+    summary_file << "," << enq_count + deq_count << "," << ms << "," << (enq_count + deq_count) / ms << "," << enq_count / ms << "," << deq_count / ms;
+    summary_file << "," << latency_at(enq_lat, 0.5) << "," << latency_at(enq_lat, 0.99) << "," << latency_at(enq_lat, 0.999) << "," << latency_at(enq_lat, 1.0);
+    summary_file << "," << latency_at(deq_lat, 0.5) << "," << latency_at(deq_lat, 0.99) << "," << latency_at(deq_lat, 0.999) << "," << latency_at(deq_lat, 1.0) << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,dequeue_count,enqueue_count,total_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].op_counts[0] << "," << results[i].op_counts[1] << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/sync/funnelRefCount.hpp"
+
+// The plain refcount: one atomic, zero is seen by whoever's fetch_sub returns 1
+class AtomicRefCount
+{
+    alignas(64) std::atomic<long long> refs;
+    int PADDING[14] = {};
+
+public:
+    AtomicRefCount(long long initial, int thread_count) : refs(initial) {}
+    void acquire(int thread_id) { refs.fetch_add(1); }
+    bool release(int thread_id) { return refs.fetch_sub(1) == 1; }
+    long long count() const { return refs.load(); }
+};
+
+// Read-mostly sharing (--mode=refcount): the main thread owns one reference to
+// each of object_count shared objects; workers take a reference to a random
+// one, read its payload for read_length steps and drop the reference. At the
+// end the owner's release must be the one and only release that saw zero.
+template <typename RefCount>
+void refcount_benchmark_loop(int thread_count, int run_milliseconds, int additional_work, int object_count, int read_length, RunResult results[], Timer &timer)
+{
+    static const int PAYLOAD = 16;
+    struct SharedObject
+    {
+        RefCount *refs;
+        long long payload[PAYLOAD];
+    };
+    std::vector<SharedObject> objects(object_count);
+    for (int i = 0; i < object_count; i++)
+    {
+        objects[i].refs = new RefCount(1, thread_count + 1);
+        for (int j = 0; j < PAYLOAD; j++)
+            objects[i].payload[j] = i;
+    }
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        // op_counts[1] are acquire/release pairs, root_access releases that saw zero
+        auto thread_func = [&](int id)
+        {
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                SharedObject &object = objects[rd_gen() % object_count];
+                object.refs->acquire(id);
+                long long sum = 0;
+                for (int i = 0; i < read_length; i++)
+                    sum += object.payload[i % PAYLOAD];
+                rd_work += sum & 1;
+                if (object.refs->release(id))
+                    result.root_access++;
+                result.op_counts[1]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    for (int i = 0; i < thread_count; i++)
+        if (results[i].root_access != 0)
+            throw std::runtime_error("A worker's release saw zero while the owner held a reference");
+    for (auto &object : objects)
+    {
+        if (!object.refs->release(thread_count))
+            throw std::runtime_error("The owner's release did not see zero");
+        delete object.refs;
+    }
+}
+
+// --impl=funnel splits the count over two TargetCounters, --impl=atomic is the
+// single-atomic refcount
+void run_refcount_benchmark(int thread_count, int run_milliseconds, int additional_work, int object_count, int read_length, std::string impl)
+{
+    RunResult results[thread_count];
+    Timer timer;
+    if (impl == "atomic")
+        refcount_benchmark_loop<AtomicRefCount>(thread_count, run_milliseconds, additional_work, object_count, read_length, results, timer);
+    else if (impl == "funnel")
+        refcount_benchmark_loop<FUNNEL_REFCOUNT::RefCount<TargetCounter>>(thread_count, run_milliseconds, additional_work, object_count, read_length, results, timer);
+    else
+        throw std::runtime_error("Unknown refcount: " + impl);
+
+    long long total_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        std::cerr << "Thread " << i << " : " << results[i].total_count << " acquire/release pairs ___ " << results[i].random_work << std::endl;
+    }
+    double ms = timer.elapsed();
+
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " pairs/ms" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,impl,object_count,read_length,total_count,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << impl << "," << object_count << "," << read_length;
+    summary_file << "," << total_count << "," << ms << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,pair_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/sched/chunkScheduler.hpp"
+
+// Cost of iteration i of n in units of additional_work:
+//  - uniform:    1
+//  - increasing: grows from 0 to 2, so the expensive part comes last
+//  - random:     1 in 16 iterations costs 16, the rest 0 (mean ~1)
+long long iteration_cost(const std::string &workload, long long i, long long n, int additional_work)
+{
+    if (workload == "increasing")
+        return 2 * additional_work * i / n;
+    if (workload == "random")
+        return (((unsigned long long)i * 0x9E3779B97F4A7C15ULL) >> 60) == 0 ? 16LL * additional_work : 0;
+    return additional_work;
+}
+
+// The main thread runs parallel_for over loop_size iterations back to back on
+// one pool of thread_count workers until the time is up (--mode=parallel-for).
+// Workers draw chunks from TargetCounter, so the hardwareCounter target is the
+// plain fetch_add scheduler.
+void run_scheduler_benchmark(int thread_count, int run_milliseconds, int additional_work, long long loop_size, long long min_chunk, std::string schedule_name, std::string workload)
+{
+    using namespace CHUNK_SCHEDULER;
+    Schedule schedule = schedule_name == "fixed" ? FIXED : schedule_name == "trapezoid" ? TRAPEZOID
+                                                                                          : GUIDED;
+    ChunkScheduler<TargetCounter> *scheduler = new ChunkScheduler<TargetCounter>(thread_count, schedule, min_chunk);
+    std::vector<long long> sinks(thread_count * 16, 0);
+
+    long long loop_count = 0;
+    Timer timer;
+    std::cout << " --- Starting loops --- " << std::endl;
+    timer.start();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(run_milliseconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        scheduler->parallel_for_chunks(0, loop_size, [&](long long from, long long to, int worker_id)
+                                       {
+            long long sink = 0;
+            for (long long i = from; i < to; i++)
+            {
+                long long cost = iteration_cost(workload, i, loop_size, additional_work);
+                for (long long k = 0; k < cost; k++)
+                    sink += (i ^ k) & 1;
+            }
+            sinks[worker_id * 16] += sink; });
+        loop_count++;
+    }
+    timer.stop();
+    std::cout << " --- Stopped all loops --- " << std::endl;
+
+    long long total_chunks = 0, min_iterations = -1, max_iterations = 0;
+    std::vector<RunResult> results(thread_count);
+    for (int i = 0; i < thread_count; i++)
+    {
+        results[i].total_count = scheduler->iteration_count(i);
+        results[i].root_access = scheduler->chunk_count(i);
+        results[i].random_work = sinks[i * 16];
+        total_chunks += results[i].root_access;
+        min_iterations = (min_iterations < 0 || results[i].total_count < min_iterations) ? results[i].total_count : min_iterations;
+        max_iterations = std::max(max_iterations, results[i].total_count);
+        std::cerr << "Thread " << i << " : " << results[i].total_count << " iterations, " << results[i].root_access << " chunks ___ " << results[i].random_work << std::endl;
+    }
+    delete scheduler;
+
+    long long total_count = loop_count * loop_size;
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Loops: " << loop_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " iterations/ms" << std::endl;
+    std::cout << "Iterations per chunk: " << std::fixed << std::setprecision(2) << (double)total_count / std::max(total_chunks, 1LL) << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,loop_size,min_chunk,schedule,workload,loop_count,total_count,total_chunks,elapsed_time,min_iterations,max_iterations,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << loop_size << "," << min_chunk << "," << schedule_name << "," << workload;
+    summary_file << "," << loop_count << "," << total_count << "," << total_chunks << "," << ms << "," << min_iterations << "," << max_iterations << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,iteration_count,chunk_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].total_count << "," << results[i].root_access << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+#include <semaphore>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/counter/fullAggregatingFunnelCounter.hpp"
+#include "../structures/sync/funnelSemaphore.hpp"
+
+// The permit count needs negative diffs: hardwareCounter builds the semaphore on
+// HardwareCounter, any other target on FullAggFunnelCounter
+#ifdef USE_HARDWARE_COUNTER
+typedef HARDWARE_ATOMIC::HardwareCounter<long long> SemaphoreCounter;
+#else
+typedef FULL_AGG_FUNNEL::FullAggFunnelCounter<long long> SemaphoreCounter;
+#endif
+
+// std::counting_semaphore behind the same interface; it only takes one permit
+// at a time, so k > 1 is refused in run_semaphore_benchmark
+class StdSemaphore
+{
+    std::counting_semaphore<> sem;
+
+public:
+    StdSemaphore(long long initial, int thread_count) : sem(initial) {}
+    void acquire(long long k, int thread_id) { sem.acquire(); }
+    void acquire_bounded(long long k, int thread_id) { sem.acquire(); }
+    void release(long long k, int thread_id) { sem.release(k); }
+};
+
+// Every thread acquires k permits, releases them and does its additional work
+// outside (--mode=semaphore). op_counts[1] are acquires, op_counts[0] releases.
+template <typename Semaphore>
+void semaphore_benchmark_loop(int thread_count, int run_milliseconds, int additional_work, long long permits, long long k, bool bounded, RunResult results[], Timer &timer)
+{
+    Semaphore *sem = new Semaphore(permits, thread_count);
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        auto thread_func = [&](int id)
+        {
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                if (bounded)
+                    sem->acquire_bounded(k, id);
+                else
+                    sem->acquire(k, id);
+                result.op_counts[1]++;
+                sem->release(k, id);
+                result.op_counts[0]++;
+                result.total_count += 2;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+            results[id] = result;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+    delete sem;
+}
+
+void run_semaphore_benchmark(int thread_count, int run_milliseconds, int additional_work, long long permits, long long k, bool bounded, std::string impl, std::string wait)
+{
+    using namespace FUNNEL_SEMAPHORE;
+    RunResult results[thread_count];
+    Timer timer;
+    if (impl == "std")
+    {
+        if (k != 1)
+            throw std::runtime_error("std::counting_semaphore takes one permit at a time, use --k=1");
+        semaphore_benchmark_loop<StdSemaphore>(thread_count, run_milliseconds, additional_work, permits, k, bounded, results, timer);
+    }
+    else if (wait == "park")
+        semaphore_benchmark_loop<FunnelSemaphore<SemaphoreCounter, WAIT_POLICY::ParkWait>>(thread_count, run_milliseconds, additional_work, permits, k, bounded, results, timer);
+    else
+        semaphore_benchmark_loop<FunnelSemaphore<SemaphoreCounter, WAIT_POLICY::SpinWait>>(thread_count, run_milliseconds, additional_work, permits, k, bounded, results, timer);
+
+    long long acquire_count = 0, release_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        acquire_count += results[i].op_counts[1];
+        release_count += results[i].op_counts[0];
+        std::cerr << "Thread " << i << " : " << results[i].op_counts[1] << " acquires ___ " << results[i].random_work << std::endl;
+    }
+    double ms = timer.elapsed();
+
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Acquire throughput: " << std::fixed << std::setprecision(2) << acquire_count / ms << " ops/ms" << std::endl;
+    std::cout << "Release throughput: " << std::fixed << std::setprecision(2) << release_count / ms << " ops/ms" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,impl,wait,permits,k,bounded,total_count,elapsed_time,acquire_throughput,release_throughput,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << impl << "," << wait << "," << permits << "," << k << "," << bounded;
+    summary_file << "," << acquire_count + release_count << "," << ms << "," << acquire_count / ms << "," << release_count / ms << "," << (acquire_count + release_count) / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,acquire_count,release_count,total_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].op_counts[1] << "," << results[i].op_counts[0] << "," << results[i].total_count << std::endl;
+    aux_file.close();
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/counter/shardedCounter.hpp"
+
+// The counter workload without fetch_add results (--mode=sharded). With
+// --impl=sharded increments are ShardedCounter::add and reads are
+// approximate_sum (--read=approx) or snapshot (--read=snapshot). With
+// --impl=counter both go to the TargetCounter of the build, as fetch_add and
+// load. Sweeping read_percent shows what a returned value and a
+// linearizable read cost.
+void run_sharded_benchmark(int thread_count, int run_milliseconds, int read_percent, int additional_work, long long diff_range, const std::string &impl, const std::string &read)
+{
+    SHARDED_COUNTER::ShardedCounter<long long> *sharded = nullptr;
+    TargetCounter *counter = nullptr;
+    if (impl == "sharded")
+        sharded = new SHARDED_COUNTER::ShardedCounter<long long>(thread_count);
+    else
+        counter = get_target_counter(thread_count);
+    bool snapshot = read == "snapshot";
+
+    const int ratios[2] = {read_percent, 100 - read_percent};
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    RunResult results[thread_count];
+    long long sums[thread_count];
+    Timer timer;
+    {
+        HarnessBarrier barrier(thread_count + 1);
+        std::atomic<bool> stop(false);
+
+        auto thread_func = [&](int id)
+        {
+            auto gen = CounterOperationGenerator(core_seed * 1000 + id, ratios, diff_range);
+            int rd_work = 0;
+            auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+            long long sum = 0;
+
+            RunResult result;
+            barrier.arrive_and_wait(id);
+
+            while (!stop.load())
+            {
+                auto op = gen.next();
+                if (std::get<0>(op) == 0)
+                {
+                    if (sharded == nullptr)
+                        rd_work += counter->load();
+                    else if (snapshot)
+                        rd_work += sharded->snapshot(id);
+                    else
+                        rd_work += sharded->approximate_sum();
+                }
+                else
+                {
+                    long long diff = std::get<1>(op);
+                    if (sharded == nullptr)
+                        rd_work += counter->fetch_add(diff, id);
+                    else
+                        sharded->add(diff, id);
+                    sum += diff;
+                }
+                result.op_counts[std::get<0>(op)]++;
+                result.total_count++;
+
+                if (additional_work > 1)
+                {
+                    int x = 1;
+                    while (x % additional_work != 0)
+                    {
+                        x = rd_gen() % additional_work;
+                        rd_work++;
+                    }
+                }
+            }
+            result.random_work = rd_work;
+#if defined(AUX_DATA) && AUX_DATA != 0
+            if (sharded == nullptr)
+                counter->update_aux_data(id, result);
+            else
+                sharded->update_aux_data(id, result);
+#endif
+            results[id] = result;
+            sums[id] = sum;
+        };
+
+        std::cout << " --- Starting threads --- " << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; i++)
+            threads.push_back(std::thread(thread_func, i));
+
+        timer.start();
+        barrier.arrive_and_wait(thread_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+        stop.store(true);
+        for (auto &t : threads)
+            t.join();
+        timer.stop();
+
+        std::cout << " --- Stopped all threads --- " << std::endl;
+    }
+
+    long long total_count = 0, read_count = 0, expected = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        read_count += results[i].op_counts[0];
+        expected += sums[i];
+        std::cerr << "Thread " << i << ": " << results[i].op_counts[0] << " " << results[i].op_counts[1] << " ___ " << results[i].random_work << std::endl;
+    }
+    long long final_value = sharded == nullptr ? counter->load() : sharded->snapshot(0);
+    delete sharded;
+    delete counter;
+    if (final_value != expected)
+        throw std::runtime_error("Sharded benchmark count does not add up");
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " ops/ms" << std::endl;
+    std::cout << "Reads: " << std::fixed << std::setprecision(2) << read_count / ms << " ops/ms" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,read_percent,additional_work,diff_range,impl,read,total_count,read_count,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << read_percent << "," << additional_work << "," << diff_range << "," << impl << "," << read;
+    summary_file << "," << total_count << "," << read_count << "," << ms << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,read_count,increment_count,loop_count_1,loop_count_2,fallback_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << results[i].op_counts[0] << "," << results[i].op_counts[1] << "," << results[i].loop_count_1 << "," << results[i].loop_count_2 << "," << results[i].fallback_count << std::endl;
+    aux_file.close();
+}
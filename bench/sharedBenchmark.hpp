@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iomanip>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "benchmarkUtils.hpp"
+#include "../structures/counter/sharedFunnelCounter.hpp"
+
+typedef SHARED_FUNNEL::SharedFunnelCounter<long long> SharedFunnel;
+
+// Start/stop flags, results and the std::atomic baseline, shared with the
+// worker processes. The funnel region follows it in the same mapping.
+struct alignas(1024) SharedControl
+{
+    alignas(128) std::atomic<int> ready = 0;
+    alignas(128) std::atomic<bool> start = false;
+    alignas(128) std::atomic<bool> stop = false;
+    alignas(128) std::atomic<long long> atomic_counter = 0;
+    alignas(128) std::atomic<int> failed = 0;
+};
+
+// thread_count workers spread round robin over process_count forked processes
+// increment one counter in shared memory (--mode=multiprocess). --impl=funnel
+// is a SharedFunnelCounter that every process attaches to, --impl=atomic a
+// plain std::atomic in the same mapping.
+void run_multiprocess_benchmark(int thread_count, int run_milliseconds, int additional_work, int process_count, int fanout, std::string impl)
+{
+    if (impl != "funnel" && impl != "atomic")
+        throw std::runtime_error("Unknown shared counter: " + impl);
+    process_count = std::max(1, std::min(process_count, thread_count));
+
+    std::size_t results_offset = sizeof(SharedControl);
+    std::size_t funnel_offset = (results_offset + thread_count * sizeof(RunResult) + 1023) / 1024 * 1024;
+    std::size_t bytes = funnel_offset + SharedFunnel::region_bytes(thread_count);
+    char *memory = (char *)SharedFunnel::map_anonymous(bytes);
+    SharedControl *control = new (memory) SharedControl();
+    RunResult *results = (RunResult *)(memory + results_offset);
+    for (int i = 0; i < thread_count; i++)
+        new (&results[i]) RunResult();
+    SharedFunnel funnel(memory + funnel_offset, bytes - funnel_offset, thread_count, fanout);
+
+    int core_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cerr << "Seed: " << core_seed << std::endl;
+
+    auto thread_func = [&](int id)
+    {
+        int rd_work = 0;
+        auto rd_gen = get_mt_generator(core_seed * 1000 + id);
+        int slot = impl == "funnel" ? funnel.register_slot() : -1;
+
+        RunResult result;
+        control->ready.fetch_add(1);
+        while (!control->start.load())
+            std::this_thread::yield();
+
+        while (!control->stop.load())
+        {
+            if (slot >= 0)
+                funnel.fetch_add(1, slot);
+            else
+                control->atomic_counter.fetch_add(1);
+            result.op_counts[1]++;
+            result.total_count++;
+
+            if (additional_work > 1)
+            {
+                int x = 1;
+                while (x % additional_work != 0)
+                {
+                    x = rd_gen() % additional_work;
+                    rd_work++;
+                }
+            }
+        }
+        result.random_work = rd_work;
+        if (slot >= 0)
+        {
+            funnel.update_aux_data(slot, result);
+            funnel.unregister_slot(slot);
+        }
+        results[id] = result;
+    };
+
+    std::cout << " --- Starting processes --- " << std::endl;
+    std::cout.flush();
+    std::cerr.flush();
+
+    std::vector<pid_t> children;
+    for (int p = 0; p < process_count; p++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("fork failed");
+        if (pid == 0)
+        {
+            // The inherited handle stays valid: the mapping is at the same address
+            std::vector<std::thread> threads;
+            for (int id = p; id < thread_count; id += process_count)
+                threads.push_back(std::thread(thread_func, id));
+            for (auto &t : threads)
+                t.join();
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    Timer timer;
+    while (control->ready.load() != thread_count)
+        std::this_thread::yield();
+    timer.start();
+    control->start.store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(run_milliseconds - 5));
+    control->stop.store(true);
+    for (pid_t pid : children)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            control->failed.fetch_add(1);
+    }
+    timer.stop();
+    std::cout << " --- Stopped all processes --- " << std::endl;
+
+    long long total_count = 0;
+    for (int i = 0; i < thread_count; i++)
+    {
+        total_count += results[i].total_count;
+        std::cerr << "Thread " << i << " (process " << i % process_count << ") : " << results[i].total_count << " ___ " << results[i].random_work << std::endl;
+    }
+    long long final_value = impl == "funnel" ? funnel.load() : control->atomic_counter.load();
+    if (control->failed.load() != 0 || final_value != total_count)
+        throw std::runtime_error("Shared counter ended at " + std::to_string(final_value) + " after " + std::to_string(total_count) + " increments");
+
+    double ms = timer.elapsed();
+    std::cout << " --- Benchmark results --- " << std::endl;
+    std::cout << "Elapsed time: " << ms << "ms" << std::endl;
+    std::cout << "Total count: " << total_count << std::endl;
+    std::cout << "Average throughput: " << std::fixed << std::setprecision(2) << total_count / ms << " ops/ms" << std::endl;
+
+    std::cout << "Writing to results_counter.csv" << std::endl;
+    std::ofstream summary_file("results/counter_main.csv");
+    summary_file << "thread_count,run_milliseconds,additional_work,impl,process_count,fanout,total_count,elapsed_time,throughput" << std::endl;
+    summary_file << thread_count << "," << run_milliseconds << "," << additional_work << "," << impl << "," << process_count << "," << fanout;
+    summary_file << "," << total_count << "," << ms << "," << total_count / ms << std::endl;
+    summary_file.close();
+
+    std::cout << "Writing to results_aux.csv" << std::endl;
+    std::ofstream aux_file("results/counter_aux.csv");
+    aux_file << "thread_id,process,op_count,root_access,fallback_count" << std::endl;
+    for (int i = 0; i < thread_count; i++)
+        aux_file << i << "," << i % process_count << "," << results[i].total_count << "," << results[i].root_access << "," << results[i].fallback_count << std::endl;
+    aux_file.close();
+
+    SharedFunnel::unmap(memory, bytes);
+}
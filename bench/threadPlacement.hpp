@@ -0,0 +1,114 @@
+#pragma once
+
+#include <sched.h>
+#include <pthread.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Where benchmark threads run (--pin=...). The CPUs the process may use are
+// read from its affinity mask, so numactl and cgroup limits still apply, and
+// their socket and core come from /sys/devices/system/cpu. Each CPU gets
+//  - socket: its physical package
+//  - core:   rank of its physical core within the socket
+//  - smt:    rank of the CPU among the hardware threads of its core
+// and the policies are orders on these:
+//  - compact:     socket, core, smt   (siblings next to each other)
+//  - scatter:     smt, core, socket   (alternate sockets, cores before siblings)
+//  - smt-last:    smt, socket, core   (every core once, socket by socket, then siblings)
+//  - socket-fill: socket, smt, core   (fill a socket's cores, then its siblings, then the next)
+// Thread i gets the i-th CPU of the order, wrapping around when there are
+// more threads than CPUs. "none" leaves placement to the scheduler.
+namespace THREAD_PLACEMENT
+{
+    struct CpuInfo
+    {
+        int cpu;
+        int socket;
+        int core;
+        int smt;
+    };
+
+    inline int read_topology_value(int cpu, const std::string &name, int fallback)
+    {
+        std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + name);
+        int value;
+        if (file >> value)
+            return value;
+        return fallback;
+    }
+
+    inline std::vector<CpuInfo> read_topology()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            throw std::runtime_error("sched_getaffinity failed");
+
+        // (socket, core_id) -> cpus; core ids repeat across sockets
+        std::map<std::pair<int, int>, std::vector<int>> cores;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &allowed))
+                cores[{read_topology_value(cpu, "physical_package_id", 0), read_topology_value(cpu, "core_id", cpu)}].push_back(cpu);
+
+        std::vector<CpuInfo> cpus;
+        std::map<int, int> cores_in_socket;
+        for (auto &[key, siblings] : cores)
+        {
+            int core = cores_in_socket[key.first]++;
+            for (int smt = 0; smt < (int)siblings.size(); smt++)
+                cpus.push_back({siblings[smt], key.first, core, smt});
+        }
+        return cpus;
+    }
+
+    inline bool is_policy(const std::string &policy)
+    {
+        return policy == "none" || policy == "compact" || policy == "scatter" || policy == "smt-last" || policy == "socket-fill";
+    }
+
+    // CPU for each of thread_count threads, -1 for no pinning
+    inline std::vector<int> plan_placement(const std::string &policy, int thread_count)
+    {
+        if (!is_policy(policy))
+            throw std::invalid_argument("Unknown pin policy: " + policy);
+        if (policy == "none")
+            return std::vector<int>(thread_count, -1);
+
+        std::vector<CpuInfo> cpus = read_topology();
+        auto key = [&](const CpuInfo &c)
+        {
+            if (policy == "compact")
+                return std::make_tuple(c.socket, c.core, c.smt);
+            if (policy == "scatter")
+                return std::make_tuple(c.smt, c.core, c.socket);
+            if (policy == "smt-last")
+                return std::make_tuple(c.smt, c.socket, c.core);
+            return std::make_tuple(c.socket, c.smt, c.core); // socket-fill
+        };
+        std::sort(cpus.begin(), cpus.end(), [&](const CpuInfo &a, const CpuInfo &b)
+                  { return key(a) < key(b); });
+
+        std::vector<int> plan(thread_count);
+        for (int i = 0; i < thread_count; i++)
+            plan[i] = cpus[i % cpus.size()].cpu;
+        return plan;
+    }
+
+    // Pins the calling thread; cpu -1 does nothing
+    inline void pin_current_thread(int cpu)
+    {
+        if (cpu < 0)
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            throw std::runtime_error("pthread_setaffinity_np failed for cpu " + std::to_string(cpu));
+    }
+}
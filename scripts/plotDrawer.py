@@ -79,6 +79,18 @@ fig4_legends = {
         "name": "RecursiveAggFunnel",
         "zorder": 20,
     },
+    "flatCombiningCounter": {
+        "marker": "s",
+        "color": "tab:gray",
+        "name": "FlatCombining",
+        "zorder": 15,
+    },
+    "combiningTreeCounter": {
+        "marker": "P",
+        "color": "tab:pink",
+        "name": "CombiningTree",
+        "zorder": 15,
+    },
 }
 
 fig5_legends = {
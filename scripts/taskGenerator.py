@@ -159,6 +159,8 @@ def trials_preset_figure4():
         "fullAggFunnelCounter",
         "combFunnelCounter",
         "recursiveAggFunnelCounter",
+        "flatCombiningCounter",
+        "combiningTreeCounter",
         "hardwareCounter",
     ]
     exec_params_fig4 = [
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include "../counter/common.hpp"
+
+// Unique ID allocator on top of any fetch_add counter. Each thread leases a
+// contiguous range with one fetch_add(size) and hands out IDs from it locally.
+// The lease size adapts to how fast the thread drains it: it doubles when the
+// last lease lasted less than TARGET_LEASE_NS and halves when it lasted more
+// than 8 times that, so hot threads touch the shared counter rarely and cold
+// threads do not sit on large ranges. IDs are unique and increase per thread
+// until it releases its lease, but only roughly across threads.
+//
+// A thread that stops allocating calls release (or lets a ThreadLease go out of
+// scope), which puts its unused range on a returned list. Refills take a
+// returned range above the thread's last ID before going to the counter, so
+// every ID below counter->load() is either handed out, in some thread's
+// lease, or on the returned list. A fresh lease (a thread's first, or the
+// first after a release) has no last ID and takes the lowest returned range,
+// which the threads with live leases are least likely to be able to use.
+namespace RANGE_ID_ALLOCATOR
+{
+    template <typename Index>
+    class RangeIdAllocator
+    {
+    private:
+        static const long long TARGET_LEASE_NS = 20000;
+
+        struct alignas(128) Lease
+        {
+            long long next = 0;
+            long long end = 0;
+            long long size = 1;
+            std::chrono::steady_clock::time_point leased_at;
+            long long refill_count = 0;
+        };
+
+        Index *counter;
+        int PADDING_1[32] = {};
+
+        long long max_lease;
+        std::vector<Lease> leases;
+        int PADDING_2[32] = {};
+
+        std::mutex returned_mtx;
+        std::vector<std::pair<long long, long long>> returned;
+        std::atomic<long long> returned_top = -1; // highest returned start, -1 if none; lets refills skip the lock
+        int PADDING_3[32] = {};
+
+        // Call with returned_mtx held
+        void update_returned_top()
+        {
+            long long top = -1;
+            for (auto &range : returned)
+                top = std::max(top, range.first);
+            returned_top.store(top, std::memory_order_relaxed);
+        }
+
+        // Only ranges starting at or above the end of the spent lease keep the
+        // thread's IDs increasing; a fresh lease has end 0
+        bool take_returned(Lease &lease)
+        {
+            if (returned_top.load(std::memory_order_relaxed) < lease.end)
+                return false;
+            std::lock_guard<std::mutex> guard(returned_mtx);
+            auto it = lease.end == 0 ? std::min_element(returned.begin(), returned.end())
+                                     : std::find_if(returned.begin(), returned.end(), [&](const std::pair<long long, long long> &range)
+                                                    { return range.first >= lease.end; });
+            if (it == returned.end())
+                return false;
+            auto [from, to] = *it;
+            returned.erase(it);
+            update_returned_top();
+            lease.next = from;
+            lease.end = to;
+            return true;
+        }
+
+        void refill(Lease &lease, int thread_id)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (lease.refill_count > 0)
+            {
+                long long lasted = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lease.leased_at).count();
+                if (lasted < TARGET_LEASE_NS)
+                    lease.size = std::min(lease.size * 2, max_lease);
+                else if (lasted > 8 * TARGET_LEASE_NS)
+                    lease.size = std::max(lease.size / 2, 1LL);
+            }
+            lease.leased_at = now;
+            lease.refill_count++;
+
+            if (take_returned(lease))
+                return;
+            lease.next = counter->fetch_add(lease.size, thread_id);
+            lease.end = lease.next + lease.size;
+        }
+
+    public:
+        RangeIdAllocator(int thread_count, long long max_lease = 4096) : max_lease(std::max(max_lease, 1LL)), leases(thread_count)
+        {
+            counter = new Index(thread_count);
+        }
+        ~RangeIdAllocator() { delete counter; }
+
+        long long next_id(int thread_id)
+        {
+            Lease &lease = leases[thread_id];
+            if (lease.next == lease.end)
+                refill(lease, thread_id);
+            return lease.next++;
+        }
+
+        // Give the unused part of this thread's lease back and reset its size
+        void release(int thread_id)
+        {
+            Lease &lease = leases[thread_id];
+            if (lease.next < lease.end)
+            {
+                std::lock_guard<std::mutex> guard(returned_mtx);
+                returned.emplace_back(lease.next, lease.end);
+                update_returned_top();
+            }
+            long long refills = lease.refill_count;
+            lease = Lease();
+            lease.refill_count = refills;
+        }
+
+        // Leases a thread took, from the counter or the returned list
+        long long refill_count(int thread_id) const { return leases[thread_id].refill_count; }
+        long long lease_size(int thread_id) const { return leases[thread_id].size; }
+
+        // IDs that were leased but never handed out: returned ranges plus the
+        // current leases. Only exact while no thread is allocating.
+        long long unused() const
+        {
+            long long total = 0;
+            for (auto &[from, to] : returned)
+                total += to - from;
+            for (auto &lease : leases)
+                total += lease.end - lease.next;
+            return total;
+        }
+
+        // Everything below this was leased at some point
+        long long high_water() const { return counter->load(); }
+    };
+
+    // Releases the thread's lease when the thread's work goes out of scope
+    template <typename Allocator>
+    class ThreadLease
+    {
+        Allocator *allocator;
+        int thread_id;
+
+    public:
+        ThreadLease(Allocator *allocator, int thread_id) : allocator(allocator), thread_id(thread_id) {}
+        ~ThreadLease() { allocator->release(thread_id); }
+        long long next_id() { return allocator->next_id(thread_id); }
+    };
+}
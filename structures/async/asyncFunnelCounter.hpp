@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <vector>
+#include <stdexcept>
+
+#include "../counter/common.hpp"
+
+// Aggregating funnel for coroutines: co_await async_fetch_add(diff, id, ex)
+// never blocks the executor thread.
+//
+// The count/sent handshake of the blocking funnels cannot be used here, since
+// the delegate of a batch has to wait for the previous batch to be sent.
+// Instead each aggregator is a stack of pending operations. The awaiter is
+// the stack entry, so it lives in the coroutine frame and nothing is
+// allocated. An operation pushes itself and suspends. The one that found the
+// stack empty is the delegate: it posts itself to the executor, which gives
+// others one round of the executor to join. When it runs again it takes the
+// whole stack, does one root fetch_add for the sum of the diffs and hands out
+// consecutive ranges of the result. Then it posts the other operations of the
+// batch to the executor and returns its own value.
+//
+// Each operation linearizes at the root fetch_add of the batch it joined. It
+// was pushed before the delegate took the stack, so that is within its
+// duration. Batches that follow each other on one aggregator are
+// independent, and no thread ever waits for another.
+namespace ASYNC_FUNNEL
+{
+    template <typename T>
+    class AsyncFunnelCounter
+    {
+    private:
+        struct FetchAdd;
+
+        struct alignas(128) Node
+        {
+            std::atomic<FetchAdd *> pending = nullptr;
+            std::atomic<long long> batch_count = 0;
+        };
+
+        struct FetchAdd
+        {
+            FetchAdd *next = nullptr;
+            T diff;
+            T result = 0;
+            std::coroutine_handle<> handle;
+        };
+
+        alignas(128) std::atomic<T> counter = 0;
+        int PADDING_1[32] = {};
+
+        std::vector<Node> nodes;
+        int thread_count;
+        int PADDING_2[32] = {};
+
+    public:
+        AsyncFunnelCounter(int thread_count) : AsyncFunnelCounter(0, thread_count, FUNNEL_STUMP::default_fanout(thread_count)) {}
+        AsyncFunnelCounter(T start, int thread_count, int fanout) : counter(start), nodes(fanout), thread_count(thread_count)
+        {
+            if (fanout < 1)
+                throw std::invalid_argument("AsyncFunnelCounter needs at least one aggregator");
+        }
+
+        template <typename Executor>
+        struct Awaiter
+        {
+            FetchAdd op;
+            AsyncFunnelCounter *funnel;
+            Node *node;
+            Executor *executor;
+            bool delegate = false;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                op.handle = h;
+                FetchAdd *top = node->pending.load();
+                do
+                {
+                    op.next = top;
+                    delegate = top == nullptr;
+                } while (!node->pending.compare_exchange_weak(top, &op));
+                // Once pushed, a non-delegate's frame belongs to the delegate
+                // of its batch, so only the local top is read here
+                if (top == nullptr)
+                    executor->post(h);
+            }
+
+            T await_resume()
+            {
+                if (delegate)
+                    funnel->send_batch(node, *executor);
+                return op.result;
+            }
+        };
+
+        template <typename Executor>
+        void send_batch(Node *node, Executor &executor)
+        {
+            FetchAdd *batch = node->pending.exchange(nullptr);
+            T sum = 0;
+            for (FetchAdd *op = batch; op != nullptr; op = op->next)
+                sum += op->diff;
+            T at = counter.fetch_add(sum);
+#if defined(AUX_DATA) && AUX_DATA != 0
+            node->batch_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+            // The delegate is the bottom entry; read next before a posted
+            // operation can resume and free its frame
+            for (FetchAdd *op = batch; op != nullptr;)
+            {
+                FetchAdd *next = op->next;
+                op->result = at;
+                at += op->diff;
+                if (next != nullptr)
+                    executor.post(op->handle);
+                op = next;
+            }
+        }
+
+        // co_await async_fetch_add(diff, id, executor) gives the value before
+        // the add. id picks the aggregator; executor needs post(handle).
+        template <typename Executor>
+        Awaiter<Executor> async_fetch_add(T diff, int thread_id, Executor &executor)
+        {
+            return Awaiter<Executor>{{nullptr, diff, 0, {}}, this, &nodes[thread_id % nodes.size()], &executor};
+        }
+
+        long long root_access() const
+        {
+            long long root_access = 0;
+            for (auto &node : nodes)
+                root_access += node.batch_count;
+            return root_access;
+        }
+
+        T load() const
+        {
+            return counter.load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            counter.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return counter.compare_exchange_strong(expected, desired);
+        }
+    };
+}
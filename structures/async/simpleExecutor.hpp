@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../common.hpp"
+
+// A small work-stealing executor for coroutines: worker_count threads, each
+// with its own queue of handles to resume. post() from a worker goes to that
+// worker's queue, from anywhere else round robin. Idle workers steal from the
+// back of other queues and yield when there is nothing to run.
+namespace ASYNC_EXECUTOR
+{
+    class SimpleExecutor
+    {
+    private:
+        struct alignas(128) Queue
+        {
+            my_mutex lock;
+            std::deque<std::coroutine_handle<>> tasks;
+        };
+
+        std::vector<Queue> queues;
+        std::vector<std::thread> workers;
+        int PADDING_1[32] = {};
+        alignas(64) std::atomic<bool> stopping = false;
+        alignas(64) std::atomic<long long> next_queue = 0;
+        int PADDING_2[32] = {};
+
+        static inline thread_local SimpleExecutor *current = nullptr;
+        static inline thread_local int current_id = -1;
+
+        bool pop(int id, std::coroutine_handle<> &task)
+        {
+            int n = queues.size();
+            for (int i = 0; i < n; i++)
+            {
+                Queue &queue = queues[(id + i) % n];
+                std::lock_guard<my_mutex> guard(queue.lock);
+                if (queue.tasks.empty())
+                    continue;
+                if (i == 0)
+                {
+                    task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                }
+                else
+                {
+                    task = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void work(int id)
+        {
+            current = this;
+            current_id = id;
+            std::coroutine_handle<> task;
+            while (!stopping.load())
+            {
+                if (pop(id, task))
+                    task.resume();
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+    public:
+        SimpleExecutor(int worker_count) : queues(worker_count)
+        {
+            for (int i = 0; i < worker_count; i++)
+                workers.push_back(std::thread(&SimpleExecutor::work, this, i));
+        }
+        // Handles still queued are dropped, so stop posting first
+        ~SimpleExecutor()
+        {
+            stopping.store(true);
+            for (auto &worker : workers)
+                worker.join();
+        }
+
+        void post(std::coroutine_handle<> task)
+        {
+            int id = current == this ? current_id : next_queue.fetch_add(1) % queues.size();
+            std::lock_guard<my_mutex> guard(queues[id].lock);
+            queues[id].tasks.push_back(task);
+        }
+
+        int worker_count() const
+        {
+            return queues.size();
+        }
+
+        // Index of the calling worker, -1 outside the executor
+        int worker_id() const
+        {
+            return current == this ? current_id : -1;
+        }
+
+        // co_await executor.schedule() continues on a worker; from a worker it
+        // goes to the back of its queue, letting others run
+        auto schedule()
+        {
+            struct Awaiter
+            {
+                SimpleExecutor *executor;
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> h) { executor->post(h); }
+                void await_resume() const noexcept {}
+            };
+            return Awaiter{this};
+        }
+    };
+
+    // Fire-and-forget coroutine: runs on the caller until its first
+    // suspension and frees itself when it returns
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+}
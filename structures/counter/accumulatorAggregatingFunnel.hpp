@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <string>
+#include <iostream>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// Funnel for a (count, sum, min, max) record, e.g. latency metrics, where one
+// record(value) updates all four fields and load() returns a consistent snapshot.
+//
+// The four 64-bit fields do not fit atomic_128, so the root is a seqlock. Its
+// writers are the delegates (and direct threads), which take the odd sequence
+// number with a CAS, so only the fanout contends on it.
+//
+// A joiner takes a ticket with a FAA on its aggregator, writes its value into
+// slot ticket % SLOT_COUNT and waits until sent passes its ticket. The delegate
+// (ticket == sent) folds the values of tickets [sent, to) into one record,
+// applies it to the root and stores sent = to. Batches are capped at SLOT_COUNT
+// tickets, and a joiner only writes its slot after the ticket SLOT_COUNT before
+// it is sent, so a slot is never overwritten before its delegate read it.
+namespace ACCUMULATOR_AGG_FUNNEL
+{
+    struct alignas(512) ThreadLocalData
+    {
+        long long access_count[64] = {};
+        long long root_access = 0;
+        long long loop_count_1 = 0;
+        long long loop_count_2 = 0;
+    };
+
+    template <typename T>
+    struct Stats
+    {
+        long long count = 0;
+        T sum = 0;
+        T min = std::numeric_limits<T>::max();
+        T max = std::numeric_limits<T>::lowest();
+
+        void add(T value)
+        {
+            count++;
+            sum += value;
+            min = value < min ? value : min;
+            max = max < value ? value : max;
+        }
+
+        void merge(const Stats &other)
+        {
+            count += other.count;
+            sum += other.sum;
+            min = other.min < min ? other.min : min;
+            max = max < other.max ? other.max : max;
+        }
+    };
+
+    template <typename T>
+    class alignas(1024) AccumulatorAggFunnel
+    {
+    private:
+        static const int SLOT_COUNT = 64;
+
+        struct alignas(64) Slot
+        {
+            std::atomic<long long> ticket = -1;
+            std::atomic<T> value;
+        };
+
+        struct alignas(1024) Node
+        {
+            alignas(128) std::atomic<long long> count = 0;
+            alignas(128) std::atomic<long long> sent = 0;
+            alignas(128) Slot slots[SLOT_COUNT];
+        };
+
+        struct alignas(128) Root
+        {
+            std::atomic<long long> seq = 0; // odd while a writer is inside
+            std::atomic<long long> count = 0;
+            std::atomic<T> sum = 0;
+            std::atomic<T> min = std::numeric_limits<T>::max();
+            std::atomic<T> max = std::numeric_limits<T>::lowest();
+        };
+
+        alignas(1024) Root root;
+        int PADDING_1[32] = {};
+
+        Node child[64];
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<int> starting_node;
+        int PADDING_3[32] = {};
+
+        std::vector<ThreadLocalData> aux_data;
+        int PADDING_4[32] = {};
+
+        void apply_to_root(const Stats<T> &batch, int thread_id)
+        {
+            long long seq = root.seq.load(std::memory_order_relaxed);
+            while ((seq & 1) || !root.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_2++;
+#endif
+                seq = root.seq.load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+
+            Stats<T> cur = read_fields();
+            cur.merge(batch);
+            root.count.store(cur.count, std::memory_order_relaxed);
+            root.sum.store(cur.sum, std::memory_order_relaxed);
+            root.min.store(cur.min, std::memory_order_relaxed);
+            root.max.store(cur.max, std::memory_order_relaxed);
+            root.seq.store(seq + 2, std::memory_order_release);
+#if defined(AUX_DATA) && AUX_DATA != 0
+            aux_data[thread_id].root_access++;
+#endif
+        }
+
+        Stats<T> read_fields() const
+        {
+            Stats<T> s;
+            s.count = root.count.load(std::memory_order_relaxed);
+            s.sum = root.sum.load(std::memory_order_relaxed);
+            s.min = root.min.load(std::memory_order_relaxed);
+            s.max = root.max.load(std::memory_order_relaxed);
+            return s;
+        }
+
+    public:
+        AccumulatorAggFunnel(int thread_count)
+        {
+            this->thread_count = thread_count;
+            starting_node.resize(thread_count, 0);
+            aux_data.resize(thread_count);
+
+            FUNNEL_STUMP::configure_from_build(starting_node);
+        }
+
+        long long max_access() const
+        {
+            return FUNNEL_STUMP::max_access(aux_data);
+        }
+        long long root_access() const
+        {
+            return FUNNEL_STUMP::root_access(aux_data);
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.loop_count_2 += aux_data[thread_id].loop_count_2;
+            result.root_access += aux_data[thread_id].root_access;
+        }
+
+        void record(T value, int thread_id)
+        {
+            int nd_idx = starting_node[thread_id];
+            if (nd_idx < 0)
+            {
+                Stats<T> single;
+                single.add(value);
+                apply_to_root(single, thread_id);
+                return;
+            }
+
+            Node *child = &this->child[nd_idx];
+            long long ticket = child->count.fetch_add(1);
+#if defined(AUX_DATA) && AUX_DATA != 0
+            aux_data[thread_id].access_count[nd_idx]++;
+#endif
+            Slot *slot = &child->slots[ticket % SLOT_COUNT];
+            long long sent = child->sent.load(std::memory_order_acquire);
+            while (sent + SLOT_COUNT <= ticket)
+            {
+                // The previous user of my slot has not been collected yet
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                sent = child->sent.load(std::memory_order_acquire);
+            }
+            slot->value.store(value, std::memory_order_relaxed);
+            slot->ticket.store(ticket, std::memory_order_release);
+
+            while (sent < ticket)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                sent = child->sent.load(std::memory_order_acquire);
+            }
+            if (sent > ticket)
+                return; // Mine is already done
+
+            // I should do the work
+            long long to = std::min(child->count.load(), ticket + SLOT_COUNT);
+            Stats<T> batch;
+            for (long long t = ticket; t < to; t++)
+            {
+                Slot *s = &child->slots[t % SLOT_COUNT];
+                while (s->ticket.load(std::memory_order_acquire) != t)
+                {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                    aux_data[thread_id].loop_count_2++;
+#endif
+                }
+                batch.add(s->value.load(std::memory_order_relaxed));
+            }
+            apply_to_root(batch, thread_id);
+            child->sent.store(to, std::memory_order_release);
+        }
+
+        Stats<T> load() const
+        {
+            while (true)
+            {
+                long long seq = root.seq.load(std::memory_order_acquire);
+                if (seq & 1)
+                    continue;
+                Stats<T> s = read_fields();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (root.seq.load(std::memory_order_relaxed) == seq)
+                    return s;
+            }
+        }
+    };
+}
@@ -15,6 +15,11 @@
 
 namespace SIMPLE_AGG_FUNNEL
 {
+    struct alignas(512) ThreadLocalData
+    {
+        long long fallback_count = 0;
+    };
+
     template <typename T>
     class alignas(1024) AggFunnelCounter : public Counter<T>
     {
@@ -32,18 +37,24 @@ namespace SIMPLE_AGG_FUNNEL
             alignas(128) std::atomic<T> count = 0;
             alignas(128) std::atomic<T> sent = 0;
             std::atomic<MappingListNode *> mapping_list = new MappingListNode();
+            std::atomic<T> orphan = -1; // position of a waiter that left before its batch started
             ~Node() { delete mapping_list.load(); }
         };
 
+        static const int DEADLINE_CHECK_STEPS = 64;
+
         alignas(1024) std::atomic<T> counter = 0;
         Node child[FIXED_AGG_COUNT];
         int PADDING[32] = {};
 
+        std::vector<ThreadLocalData> aux_data;
+        TimedMode timed_mode;
+
     public:
         inline static EpochBasedReclamation<MappingListNode> *ebr = new EpochBasedReclamation<MappingListNode>(max_thread_count);
 
-        AggFunnelCounter() {}
-        ~AggFunnelCounter() { delete ebr; }
+        AggFunnelCounter() : AggFunnelCounter(0, max_thread_count) {}
+        ~AggFunnelCounter() {} // ebr is shared by every instance
         AggFunnelCounter(int thread_count) : AggFunnelCounter(0, thread_count) {}
         AggFunnelCounter(T start, int thread_count)
         {
@@ -54,9 +65,26 @@ namespace SIMPLE_AGG_FUNNEL
             counter.store(start);
             if (thread_count > ebr->thread_count)
                 ebr = new EpochBasedReclamation<MappingListNode>(thread_count);
+            if (thread_count > (int)aux_data.size())
+                aux_data.resize(thread_count);
+        }
+
+        long long max_access() const
+        {
+            return 0;
+        }
+
+        long long root_access() const
+        {
+            return 0;
+        }
+
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.fallback_count += aux_data[thread_id].fallback_count;
         }
 
-        T update(Node *child, T child_from, T child_to, int thread_id)
+        T update(Node *child, T child_from, T child_to, int thread_id, bool timed)
         {
             T root_from = counter.fetch_add(child_to - child_from);
             // MappingListNode *new_mapping = new MappingListNode();
@@ -68,12 +96,49 @@ namespace SIMPLE_AGG_FUNNEL
             new_mapping->child_to = child_to;
             new_mapping->root_from = root_from;
             child->mapping_list.store(new_mapping, std::memory_order_release);
-            child->sent.store(child_to, std::memory_order_release);
+            // In timed mode seq_cst pairs with the orphan registration in leave
+            child->sent.store(child_to, timed ? std::memory_order_seq_cst : std::memory_order_release);
 
             ebr->retire(existing_mapping, thread_id);
             return root_from;
         }
 
+        // See ConfiguredAggFunnelCounter::adopt_orphans
+        void adopt_orphans(Node *child, T child_from, int thread_id)
+        {
+            T orphan = child->orphan.load();
+            while (orphan != -1 && orphan <= child_from)
+            {
+                if (!child->orphan.compare_exchange_strong(orphan, -1))
+                    continue;
+                if (orphan < child_from)
+                    break;
+
+                T child_to = child->count.load();
+                update(child, child_from, child_to, thread_id, true);
+                child_from = child_to;
+                orphan = child->orphan.load();
+            }
+        }
+
+        // See ConfiguredAggFunnelCounter::leave
+        bool leave(Node *child, T my_child_from)
+        {
+            T orphan = child->orphan.load();
+            if (orphan != -1 && orphan < child->sent.load())
+                child->orphan.compare_exchange_strong(orphan, -1);
+            orphan = -1;
+            if (!child->orphan.compare_exchange_strong(orphan, my_child_from))
+                return false;
+
+            if (child->sent.load() < my_child_from)
+                return true;
+            orphan = my_child_from;
+            if (child->orphan.compare_exchange_strong(orphan, -1))
+                return false;
+            return child->sent.load() <= my_child_from;
+        }
+
         T get_my_root(Node *child, T my_child_from, int thread_id)
         {
             MappingListNode *mapping = child->mapping_list.load();
@@ -109,7 +174,10 @@ namespace SIMPLE_AGG_FUNNEL
             {
                 // I should do the work
                 T child_to = child->count.load();
-                root_from = update(child, child_from, child_to, thread_id);
+                bool timed = timed_mode.delegates_adopt();
+                root_from = update(child, child_from, child_to, thread_id, timed);
+                if (timed)
+                    adopt_orphans(child, child_to, thread_id);
             }
             else
             {
@@ -120,6 +188,47 @@ namespace SIMPLE_AGG_FUNNEL
             return root_from;
         }
 
+        // See ConfiguredAggFunnelCounter::try_fetch_add for the contract
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].fallback_count++;
+#endif
+                result = counter.fetch_add(diff);
+                return true;
+            }
+            int nd_idx = thread_id % FIXED_AGG_COUNT;
+            timed_mode.enable(ebr);
+            ebr->enterCritical(thread_id);
+
+            Node *child = &this->child[nd_idx];
+            T child_from = child->count.fetch_add(diff);
+            T next_from = child->sent.load();
+            int steps = 0;
+            while (next_from < child_from)
+            {
+                if (++steps % DEADLINE_CHECK_STEPS == 0 && std::chrono::steady_clock::now() >= deadline && timed_mode.waiters_may_leave() && leave(child, child_from))
+                {
+                    ebr->exitCritical(thread_id);
+                    return false;
+                }
+                next_from = child->sent.load();
+            }
+
+            if (child_from == next_from)
+            {
+                T child_to = child->count.load();
+                result = update(child, child_from, child_to, thread_id, true);
+                adopt_orphans(child, child_to, thread_id);
+            }
+            else
+                result = get_my_root(child, child_from, thread_id);
+            ebr->exitCritical(thread_id);
+            return true;
+        }
+
         T load() const
         {
             return counter.load();
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <queue>
+#include <string>
+#include <iostream>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// Same stump layout as ConfiguredAggFunnelCounter, but non-delegates do not walk
+// a mapping list. Each delegate writes one batch record (child_from and the
+// root_from it got) into a small per-node ring and publishes its index, so a
+// waiter normally finds its result in the newest record with one acquire load
+// plus arithmetic. Older records are only needed by waiters that fell behind.
+//
+// There is no epoch based reclamation. Each record counts the diffs of waiters
+// that still have to read it, and a delegate never overwrites a record whose
+// count is not 0; it skips to the next slot instead. Since a slot may then be
+// rewritten while a late waiter scans past it, records are read under a
+// seqlock on their index, and a waiter only trusts a record whose index is
+// the one it is looking for.
+namespace BATCH_RECORD_AGG_FUNNEL
+{
+    struct alignas(512) ThreadLocalData
+    {
+        long long access_count[64] = {};
+        long long root_access = 0;
+        long long loop_count_1 = 0;
+        long long loop_count_2 = 0;
+    };
+
+    template <typename T>
+    class alignas(1024) BatchRecordAggFunnelCounter : public Counter<T>
+    {
+    private:
+        static const int RECORD_COUNT = 64;
+
+        struct alignas(64) BatchRecord
+        {
+            std::atomic<long long> index = -1; // -1 while being written
+            std::atomic<T> child_from = 0;
+            std::atomic<T> root_from = -1;
+            std::atomic<T> pending = 0; // diffs of waiters that still have to read this record
+        };
+
+        struct alignas(1024) Node
+        {
+            alignas(128) std::atomic<T> count = 0;
+            alignas(128) std::atomic<T> sent = 0;
+            std::atomic<long long> latest = -1; // index of the newest record, written before sent
+            alignas(128) BatchRecord records[RECORD_COUNT];
+        };
+
+        alignas(1024) std::atomic<T> counter = 0;
+        int PADDING_1[32] = {};
+
+        Node child[64]; // Max thread count is 64*64=4096
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<int> starting_node;
+        int PADDING_3[32] = {};
+
+        std::vector<ThreadLocalData> aux_data;
+        int PADDING_4[32] = {};
+
+    public:
+        BatchRecordAggFunnelCounter() {}
+        BatchRecordAggFunnelCounter(int thread_count) : BatchRecordAggFunnelCounter(0, thread_count) {}
+        BatchRecordAggFunnelCounter(T start, int thread_count)
+        {
+            init(start, thread_count);
+        }
+        void init(T start, int thread_count)
+        {
+            this->thread_count = thread_count;
+            counter.store(start);
+            starting_node.resize(thread_count, 0);
+            aux_data.resize(thread_count);
+
+            FUNNEL_STUMP::configure_from_build(starting_node);
+
+            for (int i = 0; i < thread_count; i++)
+            {
+                std::cerr << "Thread " << std::setw(3) << i << " goes to node " << std::setw(2) << starting_node[i] << std::endl;
+            }
+        }
+
+        long long max_access() const
+        {
+            return FUNNEL_STUMP::max_access(aux_data);
+        }
+        long long root_access() const
+        {
+            return FUNNEL_STUMP::root_access(aux_data);
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.loop_count_2 += aux_data[thread_id].loop_count_2;
+            result.root_access += aux_data[thread_id].root_access;
+        }
+
+        T update(Node *child, T child_from, T child_to, T my_diff, int thread_id)
+        {
+            // Only the current delegate writes latest, and it got the role through sent
+            long long index = child->latest.load(std::memory_order_relaxed) + 1;
+            BatchRecord *record = &child->records[index % RECORD_COUNT];
+            while (record->pending.load(std::memory_order_acquire) != 0)
+            {
+                // Someone is still behind on that record, leave that slot alone
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                record = &child->records[++index % RECORD_COUNT];
+            }
+
+            T root_from = counter.fetch_add(child_to - child_from);
+            record->index.store(-1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            record->child_from.store(child_from, std::memory_order_relaxed);
+            record->root_from.store(root_from, std::memory_order_relaxed);
+            record->pending.store(child_to - child_from - my_diff, std::memory_order_relaxed);
+            record->index.store(index, std::memory_order_release);
+
+            child->latest.store(index, std::memory_order_release);
+            child->sent.store(child_to, std::memory_order_release);
+            return root_from;
+        }
+
+        T get_my_root(Node *child, T my_child_from, T my_diff, int thread_id)
+        {
+            // Every valid record newer than ours starts after us, and ours cannot
+            // be rewritten before we release it, so the first match is ours.
+            long long index = child->latest.load(std::memory_order_acquire);
+            while (true)
+            {
+                BatchRecord *record = &child->records[index % RECORD_COUNT];
+                long long seen = record->index.load(std::memory_order_acquire);
+                T child_from = record->child_from.load(std::memory_order_relaxed);
+                T root_from = record->root_from.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seen == index && record->index.load(std::memory_order_relaxed) == index && child_from <= my_child_from)
+                {
+                    record->pending.fetch_sub(my_diff, std::memory_order_release);
+                    return root_from + my_child_from - child_from;
+                }
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_2++;
+#endif
+                index--;
+            }
+        }
+
+        T fetch_add(T diff, int thread_id)
+        {
+            int nd_idx = starting_node[thread_id];
+            if (nd_idx < 0)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].root_access++;
+#endif
+                return counter.fetch_add(diff);
+            }
+
+            Node *child = &this->child[nd_idx];
+            T child_from = child->count.fetch_add(diff);
+            T next_from = child->sent.load();
+            while (next_from < child_from)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                next_from = child->sent.load();
+            }
+
+            T root_from;
+            if (child_from == next_from)
+            {
+                // I should do the work
+                T child_to = child->count.load();
+                root_from = update(child, child_from, child_to, diff, thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].access_count[nd_idx]++;
+                aux_data[thread_id].root_access++;
+#endif
+            }
+            else
+            {
+                // Mine is already done
+                root_from = get_my_root(child, child_from, diff, thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].access_count[nd_idx]++;
+#endif
+            }
+            return root_from;
+        }
+
+        // Only the entry fallback is supported here: a waiter that left would
+        // never release its share of the batch record.
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+                result = counter.fetch_add(diff);
+            else
+                result = fetch_add(diff, thread_id);
+            return true;
+        }
+
+        T load() const
+        {
+            return counter.load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            counter.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return counter.compare_exchange_strong(expected, desired);
+        }
+    };
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <queue>
+#include <string>
+#include <cstring>
+#include <iostream>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+#include "./combiners.hpp"
+
+// Aggregating funnel for any RMW described by a combiner (see combiners.hpp),
+// e.g. fetch_or, fetch_max or exchange, on any 8 byte T including double.
+//
+// Child positions cannot be sums of operands here, so each aggregator holds a
+// 128-bit (ticket, acc) pair: joining takes the next ticket and folds the operand
+// into acc with one CAS, and remembers the acc it saw as its prefix. The
+// delegate (the ticket equal to sent) closes its batch by resetting acc to the
+// identity, applies the folded acc to the root, and publishes a batch record
+// (first ticket, root_from) the same way BatchRecordAggFunnelCounter does.
+// A waiter then returns root_from for the first ticket of the batch and
+// apply(root_from, prefix) otherwise.
+namespace COMBINER_AGG_FUNNEL
+{
+    struct alignas(512) ThreadLocalData
+    {
+        long long access_count[64] = {};
+        long long root_access = 0;
+        long long loop_count_1 = 0;
+        long long loop_count_2 = 0;
+    };
+
+    template <typename T, typename Combiner>
+    class alignas(1024) CombinerAggFunnel : public Counter<T>
+    {
+        static_assert(sizeof(T) == 8, "T must be 64 bits");
+
+    private:
+        static const int RECORD_COUNT = 64;
+
+        struct alignas(16) AggState
+        {
+            long long ticket = 0;
+            T acc;
+
+            AggState() : acc(Combiner::identity()) {}
+            AggState(long long ticket, T acc) : ticket(ticket), acc(acc) {}
+            AggState(const AggState &other) = default;
+            AggState(const volatile AggState &other) : ticket(other.ticket), acc(other.acc) {}
+            AggState &operator=(const AggState &other) = default;
+            void operator=(const AggState &other) volatile
+            {
+                ticket = other.ticket;
+                acc = other.acc;
+            }
+            // bitwise, like the CAS itself
+            bool operator==(const AggState &other) const { return std::memcmp(this, &other, sizeof(AggState)) == 0; }
+        };
+
+        struct alignas(64) BatchRecord
+        {
+            std::atomic<long long> index = -1; // -1 while being written
+            std::atomic<long long> ticket_from = 0;
+            std::atomic<T> root_from;
+            std::atomic<long long> pending = 0; // waiters that still have to read this record
+        };
+
+        struct alignas(1024) Node
+        {
+            alignas(128) atomic_128<AggState> state;
+            alignas(128) std::atomic<long long> sent = 0;
+            std::atomic<long long> latest = -1;
+            alignas(128) BatchRecord records[RECORD_COUNT];
+            Node() { state.store(AggState()); }
+        };
+
+        alignas(1024) std::atomic<T> counter;
+        int PADDING_1[32] = {};
+
+        Node child[64];
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<int> starting_node;
+        int PADDING_3[32] = {};
+
+        std::vector<ThreadLocalData> aux_data;
+        int PADDING_4[32] = {};
+
+        // Replace the aggregator state with f(state) and return the old state
+        template <typename F>
+        AggState swap_state(Node *child, F f, int thread_id)
+        {
+            AggState seen = child->state.load(); // may be torn, the CAS checks it
+            while (true)
+            {
+                AggState existed = child->state.compare_exchange(seen, f(seen));
+                if (existed == seen)
+                    return seen;
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                seen = existed;
+            }
+        }
+
+    public:
+        CombinerAggFunnel(int thread_count) : CombinerAggFunnel(Combiner::identity(), thread_count) {}
+        CombinerAggFunnel(T start, int thread_count)
+        {
+            this->thread_count = thread_count;
+            counter.store(start);
+            starting_node.resize(thread_count, 0);
+            aux_data.resize(thread_count);
+
+            FUNNEL_STUMP::configure_from_build(starting_node);
+        }
+
+        long long max_access() const
+        {
+            return FUNNEL_STUMP::max_access(aux_data);
+        }
+        long long root_access() const
+        {
+            return FUNNEL_STUMP::root_access(aux_data);
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.loop_count_2 += aux_data[thread_id].loop_count_2;
+            result.root_access += aux_data[thread_id].root_access;
+        }
+
+        T update(Node *child, long long ticket_from, int thread_id)
+        {
+            AggState closed = swap_state(
+                child, [](const AggState &s)
+                { return AggState(s.ticket, Combiner::identity()); },
+                thread_id);
+
+            long long index = child->latest.load(std::memory_order_relaxed) + 1;
+            BatchRecord *record = &child->records[index % RECORD_COUNT];
+            while (record->pending.load(std::memory_order_acquire) != 0)
+                record = &child->records[++index % RECORD_COUNT];
+
+            T root_from = Combiner::fetch_apply(counter, closed.acc);
+            record->index.store(-1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            record->ticket_from.store(ticket_from, std::memory_order_relaxed);
+            record->root_from.store(root_from, std::memory_order_relaxed);
+            record->pending.store(closed.ticket - ticket_from - 1, std::memory_order_relaxed);
+            record->index.store(index, std::memory_order_release);
+
+            child->latest.store(index, std::memory_order_release);
+            child->sent.store(closed.ticket, std::memory_order_release);
+            return root_from;
+        }
+
+        T get_my_root(Node *child, long long my_ticket, T my_prefix, int thread_id)
+        {
+            // See BatchRecordAggFunnelCounter::get_my_root
+            long long index = child->latest.load(std::memory_order_acquire);
+            while (true)
+            {
+                BatchRecord *record = &child->records[index % RECORD_COUNT];
+                long long seen = record->index.load(std::memory_order_acquire);
+                long long ticket_from = record->ticket_from.load(std::memory_order_relaxed);
+                T root_from = record->root_from.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seen == index && record->index.load(std::memory_order_relaxed) == index && ticket_from <= my_ticket)
+                {
+                    record->pending.fetch_sub(1, std::memory_order_release);
+                    // my_ticket > ticket_from, since the first ticket is the delegate
+                    return Combiner::apply(root_from, my_prefix);
+                }
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_2++;
+#endif
+                index--;
+            }
+        }
+
+        // Applies operand and returns the value right before it
+        T fetch_op(T operand, int thread_id)
+        {
+            int nd_idx = starting_node[thread_id];
+            if (nd_idx < 0)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].root_access++;
+#endif
+                return Combiner::fetch_apply(counter, operand);
+            }
+
+            Node *child = &this->child[nd_idx];
+            AggState joined = swap_state(
+                child, [operand](const AggState &s)
+                { return AggState(s.ticket + 1, Combiner::combine(s.acc, operand)); },
+                thread_id);
+            long long next_from = child->sent.load();
+            while (next_from < joined.ticket)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                next_from = child->sent.load();
+            }
+
+            T root_from;
+            if (joined.ticket == next_from)
+            {
+                // I should do the work
+                root_from = update(child, joined.ticket, thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].access_count[nd_idx]++;
+                aux_data[thread_id].root_access++;
+#endif
+            }
+            else
+            {
+                // Mine is already done
+                root_from = get_my_root(child, joined.ticket, joined.acc, thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].access_count[nd_idx]++;
+#endif
+            }
+            return root_from;
+        }
+
+        // Counter interface; what "add" means is up to the combiner
+        T fetch_add(T diff, int thread_id)
+        {
+            return fetch_op(diff, thread_id);
+        }
+
+        // Only the entry fallback is supported, as in BatchRecordAggFunnelCounter
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+                result = Combiner::fetch_apply(counter, diff);
+            else
+                result = fetch_op(diff, thread_id);
+            return true;
+        }
+
+        T load() const
+        {
+            return counter.load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            counter.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return counter.compare_exchange_strong(expected, desired);
+        }
+    };
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <type_traits>
+
+// Combiner policies for CombinerAggFunnel and HardwareRMW. A combiner describes
+// a read-modify-write "x = x (op) operand" that returns the old x, where any run
+// of operands can be folded into one operand with the same effect:
+//  - identity():              operand that leaves x unchanged
+//  - combine(a, b):           one operand with the effect of a then b
+//  - apply(x, a):             value of x after a
+//  - fetch_apply(root, a):    the RMW itself on an atomic, returns the old value
+namespace COMBINERS
+{
+    template <typename T>
+    struct AddCombiner
+    {
+        static T identity() { return 0; }
+        static T combine(T a, T b) { return a + b; }
+        static T apply(T x, T a) { return x + a; }
+        static T fetch_apply(std::atomic<T> &root, T a)
+        {
+            if constexpr (std::is_integral<T>::value)
+                return root.fetch_add(a);
+            else
+            {
+                T cur = root.load();
+                while (!root.compare_exchange_weak(cur, cur + a))
+                    ;
+                return cur;
+            }
+        }
+    };
+
+    template <typename T>
+    struct OrCombiner
+    {
+        static T identity() { return 0; }
+        static T combine(T a, T b) { return a | b; }
+        static T apply(T x, T a) { return x | a; }
+        static T fetch_apply(std::atomic<T> &root, T a) { return root.fetch_or(a); }
+    };
+
+    template <typename T>
+    struct AndCombiner
+    {
+        static T identity() { return ~T(0); }
+        static T combine(T a, T b) { return a & b; }
+        static T apply(T x, T a) { return x & a; }
+        static T fetch_apply(std::atomic<T> &root, T a) { return root.fetch_and(a); }
+    };
+
+    template <typename T>
+    struct MaxCombiner
+    {
+        static T identity() { return std::numeric_limits<T>::lowest(); }
+        static T combine(T a, T b) { return a < b ? b : a; }
+        static T apply(T x, T a) { return x < a ? a : x; }
+        static T fetch_apply(std::atomic<T> &root, T a)
+        {
+            // Linearizes at the load when the root is already large enough
+            T cur = root.load();
+            while (cur < a && !root.compare_exchange_weak(cur, a))
+                ;
+            return cur;
+        }
+    };
+
+    template <typename T>
+    struct MinCombiner
+    {
+        static T identity() { return std::numeric_limits<T>::max(); }
+        static T combine(T a, T b) { return b < a ? b : a; }
+        static T apply(T x, T a) { return a < x ? a : x; }
+        static T fetch_apply(std::atomic<T> &root, T a)
+        {
+            T cur = root.load();
+            while (a < cur && !root.compare_exchange_weak(cur, a))
+                ;
+            return cur;
+        }
+    };
+
+    // Each operation gets the value written by its predecessor. identity() is
+    // never observed: the first operation of a batch gets the root's old value.
+    template <typename T>
+    struct ExchangeCombiner
+    {
+        static T identity() { return T(); }
+        static T combine(T a, T b) { return b; }
+        static T apply(T x, T a) { return a; }
+        static T fetch_apply(std::atomic<T> &root, T a) { return root.exchange(a); }
+    };
+}
@@ -6,13 +6,27 @@
 #include <stack>
 #include <mutex>
 
+// Combining funnel (Shavit and Zemach). An operation walks down the layers,
+// swapping its record into a random slot of each layer and trying to capture
+// the record it found there. A captured operation waits for its result, and
+// its captor adds its sum and later hands out its range. The operation that
+// gets to the end tries to CAS the sum into the counter.
+//
+// Layer widths, depth and spin time adapt per thread to how often collisions
+// succeed:
+//  - capturing someone widens the layers this thread uses (shift - 1), and a
+//    failed capture narrows them (shift + 1), down to a single slot
+//  - failing at a single slot makes the thread skip a layer (depth - 1), and
+//    a failed CAS on the counter adds one back (depth + 1). So at low load
+//    threads go straight to the counter, and layers appear as it gets contended.
+//  - being captured while spinning doubles the spin time, and spinning in
+//    vain halves it
+// -DCOMB_FUNNEL_FIXED keeps the full depth, full width and 100 spins instead.
+//
+// Each thread reuses one record. A slot may still point to a record whose
+// operation finished; its status is then 2, so a capture attempt fails.
 namespace COMB_FUNNEL
 {
-    struct alignas(128) ThreadLocalData
-    {
-        long long root_access = 0;
-    };
-
     template <typename T>
     class alignas(1024) CombiningFunnelCounter : public Counter<T>
     {
@@ -26,9 +40,8 @@ namespace COMB_FUNNEL
 
         struct alignas(128) OperationStatus
         {
-            std::atomic<int> status = 0; // instead of location. can be (0, 1, 2)
-            std::atomic<OperationType *> operation = new OperationType();
-            ~OperationStatus() { delete operation.load(); }
+            std::atomic<int> status = 2; // 1: can be captured, 2: locked or done
+            std::atomic<OperationType *> operation = nullptr;
         };
 
         struct alignas(128) FunnelNode
@@ -46,7 +59,29 @@ namespace COMB_FUNNEL
             }
         };
 
+        struct alignas(512) ThreadLocalData
+        {
+            OperationStatus status;
+            OperationType operation;
+            std::vector<std::pair<OperationStatus *, T>> collisions;
+            RandomGenerator rand;
+            int shift = 0; // layer i uses layer_width[i] >> shift slots
+            int depth = 0; // layers visited before trying the counter
+            int spin = 0;  // polls of the own status after each layer
+            long long root_access = 0;
+            long long capture_count = 0;
+            long long root_failure_count = 0;
+        };
+
         static const int NUM_LAYERS = 10;
+#ifdef COMB_FUNNEL_FIXED
+        static const bool ADAPTIVE = false;
+#else
+        static const bool ADAPTIVE = true;
+#endif
+        static const int FIXED_SPIN = 100;
+        static const int MIN_SPIN = 8;
+        static const int MAX_SPIN = 1024;
 
         int layer_width[NUM_LAYERS];
         int thread_count;
@@ -57,25 +92,16 @@ namespace COMB_FUNNEL
         FunnelNode funnel[NUM_LAYERS][1 << 8]; // 256
         int PADDING_2[32] = {};
 
-        RandomGenerator gens[1 << 8];
-        int PADDING_3[32] = {};
-
         std::atomic<T> counter;
         int PADDING_4[32] = {};
 
     public:
         CombiningFunnelCounter(int thread_count) : CombiningFunnelCounter(0, thread_count) {}
-        CombiningFunnelCounter(T start, int thread_count)
+        CombiningFunnelCounter(T start, int thread_count) : aux_data(thread_count)
         {
             this->thread_count = thread_count;
-            aux_data.resize(thread_count);
             counter.store(start);
 
-            int time_seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-            time_seed %= 1000007;
-            for (int i = 0; i < 1 << 8; i++)
-                gens[i].seed = time_seed * 100 + i;
-
             int cur = 1;
             layer_count = 0;
             while (2 * cur < thread_count)
@@ -88,7 +114,18 @@ namespace COMB_FUNNEL
             for (int i = layer_count - 1; i >= 0; i--)
                 layer_width[i] = layer_width[i + 1] * 2;
 
-            std::cerr << "layer_count: " << layer_count << std::endl;
+            int time_seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            time_seed %= 1000007;
+            for (int i = 0; i < thread_count; i++)
+            {
+                ThreadLocalData &local = aux_data[i];
+                local.status.operation.store(&local.operation);
+                local.rand.seed = time_seed * 100 + i;
+                local.depth = ADAPTIVE ? 0 : layer_count;
+                local.spin = ADAPTIVE ? MIN_SPIN : FIXED_SPIN;
+            }
+
+            std::cerr << "layer_count: " << layer_count << (ADAPTIVE ? " (adaptive)" : " (fixed)") << std::endl;
             std::cerr << "layer_width: ";
             for (int i = 0; i <= layer_count; i++)
                 std::cerr << layer_width[i] << " ";
@@ -102,54 +139,71 @@ namespace COMB_FUNNEL
         }
         long long root_access() const
         {
-            // throw std::runtime_error("Not implemented");
             long long sum = 0;
             for (int i = 0; i < thread_count; i++)
                 sum += aux_data[i].root_access;
             return sum;
         }
+        // loop_count_1 counts captures, loop_count_2 failed CASes on the counter
         void update_aux_data(int thread_id, RunResult &result) const
         {
-            return;
+            result.root_access += aux_data[thread_id].root_access;
+            result.loop_count_1 += aux_data[thread_id].capture_count;
+            result.loop_count_2 += aux_data[thread_id].root_failure_count;
         }
 
         T fetch_add(T diff, int thread_id)
         {
-            OperationType *op = new OperationType();
-            op->sum = diff;
-            OperationStatus *my_status = new OperationStatus();
+            ThreadLocalData &local = aux_data[thread_id];
+            OperationStatus *my_status = &local.status;
+            OperationType *op = &local.operation;
+            op->result.store(-1);
+            op->sum.store(diff);
+            local.collisions.clear();
             my_status->status.store(1);
-            my_status->operation = op;
-            RandomGenerator &gen = gens[thread_id];
 
-            std::vector<std::pair<OperationStatus *, T>> collisions;
             int _tmp = 1;
 
             while (true)
             {
-                for (int i = 0; i < layer_count; i++)
+                for (int i = 0; i < local.depth; i++)
                 {
-                    int r = gen.next() % layer_width[i];
+                    int r = local.rand.next() % std::max(layer_width[i] >> local.shift, 1);
                     OperationStatus *q = funnel[i][r].statp.exchange(my_status);
 
                     _tmp = 1;
                     if (my_status->status.compare_exchange_strong(_tmp, 2))
                     {
                         _tmp = 1;
-                        if (q != nullptr && q->status.compare_exchange_strong(_tmp, 2))
+                        if (q != nullptr && q != my_status && q->status.compare_exchange_strong(_tmp, 2))
                         {
                             T q_diff = q->operation.load()->sum.load();
-                            collisions.push_back(std::make_pair(q, q_diff));
+                            local.collisions.push_back(std::make_pair(q, q_diff));
                             op->sum += q_diff;
+#if defined(AUX_DATA) && AUX_DATA != 0
+                            local.capture_count++;
+#endif
+                            if (ADAPTIVE && local.shift > 0)
+                                local.shift--;
                         }
+                        else if (ADAPTIVE && layer_width[0] >> local.shift > 1)
+                            local.shift++;
+                        else if (ADAPTIVE && i == local.depth - 1)
+                            local.depth--;
                         my_status->status.store(1);
                     }
                     else
                         goto distribute;
 
-                    for (int i = 0; i < 100; i++)
+                    for (int k = 0; k < local.spin; k++)
                         if (my_status->status.load() == 2)
+                        {
+                            if (ADAPTIVE)
+                                local.spin = std::min(local.spin * 2, MAX_SPIN);
                             goto distribute;
+                        }
+                    if (ADAPTIVE)
+                        local.spin = std::max(local.spin / 2, MIN_SPIN);
                 }
 
                 _tmp = 1;
@@ -160,12 +214,18 @@ namespace COMB_FUNNEL
                     if (counter.compare_exchange_strong(tmp, current + op->sum.load()))
                     {
                         op->result.store(current);
-                        // assert(my_status->status.load() == 2);
-                        aux_data[thread_id].root_access++;
+                        local.root_access++;
                         goto distribute;
                     }
+#if defined(AUX_DATA) && AUX_DATA != 0
+                    local.root_failure_count++;
+#endif
+                    if (ADAPTIVE && local.depth < layer_count)
+                        local.depth++;
                     my_status->status.store(1);
                 }
+                else
+                    goto distribute;
             }
 
         distribute:
@@ -174,14 +234,27 @@ namespace COMB_FUNNEL
 
             T subtotal = diff;
             T prior = op->result.load();
-            for (auto &[q, qsum] : collisions)
+            for (auto &[q, qsum] : local.collisions)
             {
                 q->operation.load()->result = prior + subtotal;
                 subtotal += qsum;
             }
 
-            long long result = op->result.load();
-            return result;
+            return prior;
+        }
+
+        // Only the entry fallback is supported here: once an operation has been
+        // combined into someone else's, its owner has to wait for the result.
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                aux_data[thread_id].root_access++;
+                result = counter.fetch_add(diff);
+            }
+            else
+                result = fetch_add(diff, thread_id);
+            return true;
         }
 
         T load() const
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// Static software combining tree (Goodman, Vernon and Woest; the version in
+// Herlihy and Shavit) as a fetch_add baseline. Threads start at leaf
+// thread_id / arity of a full tree with the given arity, and the counter sits
+// above the top node. An operation goes through three phases:
+//  - precombine: climb while the nodes are free, taking each one it passes.
+//    At a node that another climber owns it joins that owner and stops.
+//  - combine: lock the taken nodes for new arrivals, bottom up, and add the
+//    values the joiners left there. The joiner of the stop node gets the sum,
+//    or the thread that took the top node adds it to the counter.
+//  - distribute: walk down again, handing each joiner its range after the
+//    owner's own part, and free the nodes.
+//
+// Unlike the funnels the tree is deterministic: who combines with whom only
+// depends on timing at fixed nodes, and an operation passes depth + 1 of
+// them. A node is closed from the combine of its owner until its joiners
+// have read their results; arrivals wait at its door.
+namespace COMBINING_TREE
+{
+    template <typename T>
+    class alignas(1024) CombiningTreeCounter : public Counter<T>
+    {
+    private:
+        static const int MAX_ARITY = 16;
+        // try_fetch_add polls the clock once every this many spins
+        static const int DEADLINE_CHECK_STEPS = 64;
+        static const int CLIMB = 0, JOIN = 1, TIMED_OUT = 2;
+
+        struct alignas(128) Node
+        {
+            my_mutex lock;
+            std::atomic<bool> closed = false;
+            bool owned = false; // under lock
+            int joined = 0;     // under lock until closed
+            alignas(64) std::atomic<int> deposited = 0;
+            std::atomic<bool> ready = false;
+            std::atomic<int> uncollected = 0;
+            T first_value = 0;
+            T values[MAX_ARITY] = {};
+            T results[MAX_ARITY] = {};
+            Node *parent = nullptr;
+        };
+
+        struct alignas(512) ThreadLocalData
+        {
+            std::vector<Node *> path; // nodes taken by the current operation
+            long long root_access = 0;
+            long long loop_count_1 = 0;
+            long long fallback_count = 0;
+        };
+
+        alignas(1024) std::atomic<T> counter = 0;
+        int PADDING_1[32] = {};
+
+        std::vector<Node> nodes;
+        int arity;
+        int leaf_offset;
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<ThreadLocalData> local_data;
+        int PADDING_3[32] = {};
+
+        static int default_arity()
+        {
+#if defined(TREE_ARITY) && TREE_ARITY > 0
+            return TREE_ARITY;
+#else
+            return 2;
+#endif
+        }
+
+        // Index of the first leaf in the smallest full tree with a leaf for
+        // every arity threads; the tree has first_leaf * arity + 1 nodes
+        static int first_leaf(int thread_count, int arity)
+        {
+            if (arity < 2 || arity > MAX_ARITY)
+                throw std::invalid_argument("CombiningTreeCounter arity must be in [2, 16]");
+            int leaves_needed = (thread_count + arity - 1) / arity;
+            int offset = 0, width = 1;
+            while (width < leaves_needed)
+            {
+                offset += width;
+                width *= arity;
+            }
+            return offset;
+        }
+
+        int precombine(Node *node, int &slot, int thread_id, bool timed, Deadline deadline)
+        {
+            int steps = 0;
+            node->lock.lock();
+            while (node->closed.load())
+            {
+                node->lock.unlock();
+                while (node->closed.load())
+                {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                    local_data[thread_id].loop_count_1++;
+#endif
+                    if (timed && ++steps % DEADLINE_CHECK_STEPS == 0 && std::chrono::steady_clock::now() >= deadline)
+                        return TIMED_OUT;
+                }
+                node->lock.lock();
+            }
+            int outcome = CLIMB;
+            if (!node->owned)
+                node->owned = true;
+            else
+            {
+                slot = node->joined++;
+                outcome = JOIN;
+            }
+            node->lock.unlock();
+            return outcome;
+        }
+
+        T combine(Node *node, T combined, int thread_id)
+        {
+            node->lock.lock();
+            node->closed.store(true);
+            int joined = node->joined;
+            node->lock.unlock();
+            while (node->deposited.load() != joined)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                local_data[thread_id].loop_count_1++;
+#endif
+            }
+            node->first_value = combined;
+            for (int i = 0; i < joined; i++)
+                combined += node->values[i];
+            return combined;
+        }
+
+        T join(Node *node, int slot, T combined, int thread_id)
+        {
+            node->values[slot] = combined;
+            node->deposited.fetch_add(1);
+            while (!node->ready.load())
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                local_data[thread_id].loop_count_1++;
+#endif
+            }
+            T prior = node->results[slot];
+            if (node->uncollected.fetch_sub(1) == 1)
+                reopen(node);
+            return prior;
+        }
+
+        void distribute(Node *node, T prior)
+        {
+            int joined = node->joined;
+            if (joined == 0)
+            {
+                reopen(node);
+                return;
+            }
+            T at = prior + node->first_value;
+            for (int i = 0; i < joined; i++)
+            {
+                node->results[i] = at;
+                at += node->values[i];
+            }
+            node->uncollected.store(joined);
+            node->ready.store(true);
+        }
+
+        void reopen(Node *node)
+        {
+            node->owned = false;
+            node->joined = 0;
+            node->deposited.store(0);
+            node->ready.store(false);
+            node->closed.store(false);
+        }
+
+        T apply(T diff, int thread_id, bool timed, Deadline deadline)
+        {
+            ThreadLocalData &local = local_data[thread_id];
+            Node *node = &nodes[leaf_offset + thread_id / arity];
+            Node *stop = nullptr; // nullptr: the counter
+            int depth = 0, slot = -1;
+            while (node != nullptr)
+            {
+                int outcome = precombine(node, slot, thread_id, timed, deadline);
+                if (outcome == JOIN)
+                {
+                    stop = node;
+                    break;
+                }
+                if (outcome == TIMED_OUT)
+                {
+                    // Whatever was combined below goes to the counter directly
+#if defined(AUX_DATA) && AUX_DATA != 0
+                    local.fallback_count++;
+#endif
+                    break;
+                }
+                local.path[depth++] = node;
+                node = node->parent;
+            }
+
+            T combined = diff;
+            for (int i = 0; i < depth; i++)
+                combined = combine(local.path[i], combined, thread_id);
+
+            T prior;
+            if (stop != nullptr)
+                prior = join(stop, slot, combined, thread_id);
+            else
+            {
+                prior = counter.fetch_add(combined);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                local.root_access++;
+#endif
+            }
+
+            for (int i = depth - 1; i >= 0; i--)
+                distribute(local.path[i], prior);
+            return prior;
+        }
+
+    public:
+        CombiningTreeCounter(int thread_count) : CombiningTreeCounter(0, thread_count, default_arity()) {}
+        CombiningTreeCounter(T start, int thread_count) : CombiningTreeCounter(start, thread_count, default_arity()) {}
+        CombiningTreeCounter(T start, int thread_count, int arity)
+            : counter(start), nodes(first_leaf(thread_count, arity) * arity + 1), arity(arity),
+              leaf_offset(first_leaf(thread_count, arity)), thread_count(thread_count), local_data(thread_count)
+        {
+            for (int i = 1; i < (int)nodes.size(); i++)
+                nodes[i].parent = &nodes[(i - 1) / arity];
+            int levels = 1;
+            for (Node *node = &nodes.back(); node->parent != nullptr; node = node->parent)
+                levels++;
+            for (auto &local : local_data)
+                local.path.resize(levels);
+        }
+
+        long long max_access() const
+        {
+            return root_access();
+        }
+        long long root_access() const
+        {
+            long long root_access = 0;
+            for (int i = 0; i < thread_count; i++)
+                root_access += local_data[i].root_access;
+            return root_access;
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.root_access += local_data[thread_id].root_access;
+            result.loop_count_1 += local_data[thread_id].loop_count_1;
+            result.fallback_count += local_data[thread_id].fallback_count;
+        }
+
+        T fetch_add(T diff, int thread_id)
+        {
+            return apply(diff, thread_id, false, Deadline());
+        }
+
+        // Only waiting at a closed node is bounded: on timeout the thread stops
+        // climbing and adds what it has combined to the counter itself. Once it
+        // joined someone it waits for its result. Always succeeds.
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            result = apply(diff, thread_id, true, deadline);
+            return true;
+        }
+
+        // The counter above the tree is a plain atomic
+        T load() const
+        {
+            return counter.load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            counter.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return counter.compare_exchange_strong(expected, desired);
+        }
+    };
+}
@@ -1,7 +1,25 @@
 #pragma once
 
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <algorithm>
 #include "../common.hpp"
 
+// Absolute time point used by the deadline-bounded try_fetch_add
+typedef std::chrono::steady_clock::time_point Deadline;
+
+// Memory orders on the funnel hot paths. Building with -DUSE_RELAXED_ORDERING
+// weakens them in ConfiguredAggFunnelCounter and RecursiveAggFunnelCounter;
+// see the argument in configuredAggregatingFunnelCounter.hpp.
+#ifdef USE_RELAXED_ORDERING
+static constexpr std::memory_order FUNNEL_RELAXED = std::memory_order_relaxed;
+static constexpr std::memory_order FUNNEL_ACQUIRE = std::memory_order_acquire;
+#else
+static constexpr std::memory_order FUNNEL_RELAXED = std::memory_order_seq_cst;
+static constexpr std::memory_order FUNNEL_ACQUIRE = std::memory_order_seq_cst;
+#endif
+
 struct RunResult
 {
     long long op_counts[2] = {0, 0};
@@ -12,13 +30,115 @@ struct RunResult
     long long loop_count_2 = 0; // traverse through the list
 
     long long root_access = 0;
+
+    long long timeout_count = 0;  // try_fetch_add left a slow batch
+    long long fallback_count = 0; // try_fetch_add went straight to the root
 };
 
+// The stump of the aggregating funnels: starting_node[i] is the aggregator
+// thread i joins (1..fanout), or -k if it goes straight to the root as the
+// root's k-th child.
+namespace FUNNEL_STUMP
+{
+    // ceil(sqrt(thread_count))
+    inline int sqrt_fanout(int thread_count)
+    {
+        int block = 1;
+        while (block * block < thread_count)
+            block++;
+        return block;
+    }
+
+    // The first direct threads go to the root, the others round robin over
+    // fanout aggregators. Returns the root's fanout.
+    inline int configure_fixed_fanout(std::vector<int> &starting_node, int fanout, int direct = 0)
+    {
+        int thread_count = starting_node.size();
+        int root_fanout = fanout;
+        for (int i = direct; i < thread_count; i++)
+            starting_node[i] = i % fanout + 1;
+        for (int i = 0; i < direct; i++)
+        {
+            root_fanout++;
+            starting_node[i] = -root_fanout;
+        }
+        return root_fanout;
+    }
+
+    inline int configure_root_fanout(std::vector<int> &starting_node, int direct = 0)
+    {
+        return configure_fixed_fanout(starting_node, sqrt_fanout(starting_node.size()), direct);
+    }
+
+    // The stump picked by the build flags: USE_ROOT_AGGS or USE_FIXED_AGGS,
+    // with AGG_COUNT and DIRECT_COUNT, and 6 aggregators otherwise
+    inline int configure_from_build(std::vector<int> &starting_node)
+    {
+#ifdef DIRECT_COUNT
+        int direct = DIRECT_COUNT;
+#else
+        int direct = 0;
+#endif
+
+#if defined(AGG_COUNT) && AGG_COUNT > 0
+        int fanout = AGG_COUNT;
+#else
+        int fanout = 1;
+#endif
+
+#ifdef USE_ROOT_AGGS
+        std::cout << "Using root stump with direct=" << direct << std::endl;
+        return configure_root_fanout(starting_node, direct);
+#elif defined USE_FIXED_AGGS
+        std::cout << "Using fixed stump with fanout=" << fanout << " and direct=" << direct << std::endl;
+        return configure_fixed_fanout(starting_node, fanout, direct);
+#else
+        std::cout << "(DEFAULT) Using fixed stump with fanout=" << 6 << " and direct=" << 0 << std::endl;
+        return configure_fixed_fanout(starting_node, 6, 0);
+#endif
+    }
+
+    // Aggregator count for funnels that only take AGG_COUNT
+    inline int default_fanout(int thread_count)
+    {
+#if defined(AGG_COUNT) && AGG_COUNT > 0
+        return AGG_COUNT;
+#else
+        return sqrt_fanout(thread_count);
+#endif
+    }
+
+    // Sums over per-thread aux data with root_access and access_count[64]
+    template <typename ThreadLocalData>
+    long long root_access(const std::vector<ThreadLocalData> &aux_data)
+    {
+        long long root_access = 0;
+        for (auto &local : aux_data)
+            root_access += local.root_access;
+        return root_access;
+    }
+
+    // Accesses of the busiest node, the root included
+    template <typename ThreadLocalData>
+    long long max_access(const std::vector<ThreadLocalData> &aux_data)
+    {
+        long long node_access[64] = {};
+        for (auto &local : aux_data)
+            for (int j = 0; j < 64; j++)
+                node_access[j] += local.access_count[j];
+        long long max_access = root_access(aux_data);
+        for (int i = 0; i < 64; i++)
+            max_access = std::max(max_access, node_access[i]);
+        return max_access;
+    }
+}
+
 template <typename T>
 class Counter
 {
 public:
     virtual T fetch_add(T diff, int thread_id);
+    bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result);
     virtual T load() const;
     virtual void store(T value, std::memory_order order = std::memory_order_seq_cst);
     virtual bool compare_exchange(T &expected, T desired);
@@ -36,6 +156,11 @@ public:
     {
         return 0;
     }
+    bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+    {
+        result = 0;
+        return true;
+    }
     T load() const
     {
         return 0;
@@ -55,3 +180,57 @@ public:
     }
     void update_aux_data(int thread_id, RunResult &result) const {}
 };
+
+// Deadline support in the aggregating funnels costs the delegates a seq_cst
+// store of sent and a look at the orphan slot (see
+// ConfiguredAggFunnelCounter::try_fetch_add). A counter only pays for it once
+// try_fetch_add has been called on it:
+//  - OFF: delegates use a release store of sent and skip orphans; waiters
+//    never leave.
+//  - SWITCHING: delegates that read the state from now on do the timed
+//    handshake. Waiters still stay, since a delegate that read OFF may still
+//    be running.
+//  - ON: every thread has been seen outside its EBR critical section since
+//    the switch, so no delegate that read OFF is left and waiters may leave.
+// try_fetch_add calls enable() before entering its critical section; it never
+// waits, it only moves the check past the threads that are outside. The state
+// is read inside critical sections, where seq_cst loads are plain loads on x86.
+class TimedMode
+{
+private:
+    static const int OFF = 0, SWITCHING = 1, ON = 2;
+    alignas(64) std::atomic<int> state = OFF;
+    std::atomic<int> checked = 0; // threads seen outside since the switch
+    int PADDING[16] = {};
+
+public:
+    bool delegates_adopt() const
+    {
+        return state.load() != OFF;
+    }
+
+    bool waiters_may_leave() const
+    {
+        return state.load() == ON;
+    }
+
+    template <typename Reclamation>
+    void enable(Reclamation *ebr)
+    {
+        int current = state.load();
+        if (current == ON)
+            return;
+        if (current == OFF)
+            state.compare_exchange_strong(current, SWITCHING);
+        int i = checked.load();
+        int n = ebr->tls.size();
+        while (i < n)
+        {
+            if (ebr->tls[i].announcement.load() != -1)
+                return;
+            if (checked.compare_exchange_strong(i, i + 1))
+                i++;
+        }
+        state.store(ON);
+    }
+};
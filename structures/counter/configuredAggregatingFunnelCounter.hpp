@@ -11,6 +11,34 @@
 #include "./common.hpp"
 #endif
 
+// Memory ordering (USE_RELAXED_ORDERING, also used by RecursiveAggFunnelCounter)
+//
+// Every fetch_add linearizes at the root fetch_add of the batch that carries it,
+// at position (my_child_from - child_from) inside that batch. This only relies on
+// three facts, none of which needs seq_cst:
+//  1. All RMWs on one atomic are totally ordered by its modification order and
+//     each reads the value right before its own write, whatever memory order is
+//     used. So the root fetch_add results of different batches never overlap,
+//     and count.fetch_add hands out disjoint child ranges (FUNNEL_RELAXED).
+//  2. A batch only contains operations that had already been invoked: the
+//     delegate includes exactly the count.fetch_adds that precede its own
+//     count.load in count's modification order, and every one of them is still
+//     waiting since it cannot return before sent passes it. That load may be
+//     relaxed, since coherence already makes it see its own thread's RMW.
+//  3. A waiter reads the mapping written for its batch. The delegate writes the
+//     mapping node, publishes it with a release store of mapping_list and then of
+//     sent. A waiter leaves the spin loop with an acquire load of sent that reads
+//     that store (or a later one in the release sequence), so the node and every
+//     older node reachable through prev are visible (FUNNEL_ACQUIRE on sent and
+//     mapping_list). The next delegate gets its role through the same acquire.
+// load() is an acquire load of the root, so it also reads some point of the
+// modification order. What is given up is that fetch_add no longer acts as a
+// full fence for the caller's unrelated memory accesses.
+//
+// Once try_fetch_add is in use (see TimedMode), the sent store and the orphan
+// accesses are seq_cst, since that handshake is a store-then-load pattern on
+// two different locations. Until then delegates keep the release store and do
+// not look for orphans.
 namespace CONFIGURED_AGG_FUNNEL
 {
 
@@ -29,6 +57,8 @@ namespace CONFIGURED_AGG_FUNNEL
         long long root_access = 0;
         long long loop_count_1 = 0;
         long long loop_count_2 = 0;
+        long long fallback_count = 0;
+        int bypass_left = 0; // try_fetch_add calls to send to the root after a timeout
         RandomGenerator rand;
     };
 
@@ -49,9 +79,15 @@ namespace CONFIGURED_AGG_FUNNEL
             alignas(128) std::atomic<T> count = 0;
             alignas(128) std::atomic<T> sent = 0;
             std::atomic<MappingListNode *> mapping_list = new MappingListNode();
+            std::atomic<T> orphan = -1; // position of a waiter that left before its batch started
             ~Node() { delete mapping_list.load(); }
         };
 
+        // try_fetch_add polls the clock once every this many spins
+        static const int DEADLINE_CHECK_STEPS = 64;
+        // and after a timeout, skips the funnel for this many calls
+        static const int BYPASS_STEPS = 64;
+
         alignas(1024) std::atomic<T> counter = 0;
         int PADDING_1[32] = {};
 
@@ -66,28 +102,29 @@ namespace CONFIGURED_AGG_FUNNEL
         EpochBasedReclamation<MappingListNode> *ebr = nullptr;
         int PADDING_4[32] = {};
 
-        int configure_fixed_fanout(int fanout, int direct = 0)
-        {
-            int root_fanout = fanout;
-            for (int i = direct; i < thread_count; i++)
-            {
-                starting_node[i] = i % fanout + 1;
-            }
-
-            for (int i = 0; i < direct; i++)
-            {
-                root_fanout++;
-                starting_node[i] = -root_fanout;
-            }
-            return root_fanout;
-        }
+        TimedMode timed_mode;
 
-        int configure_root_fanout(int direct = 0)
+        // Try to detach the waiter at my_child_from. Returns false if the waiter
+        // has to stay, either because another orphan is pending or because its
+        // batch became ready in the meantime.
+        bool leave(Node *child, T my_child_from)
         {
-            int block = 1; // ceil(sqrt(thread_count))
-            while ((block) * (block) < (thread_count))
-                block++;
-            return configure_fixed_fanout(block, direct);
+            T orphan = child->orphan.load();
+            if (orphan != -1 && orphan < child->sent.load())
+                child->orphan.compare_exchange_strong(orphan, -1); // clear a stale one
+            orphan = -1;
+            if (!child->orphan.compare_exchange_strong(orphan, my_child_from))
+                return false;
+
+            // seq_cst pairs with the sent store in update: either the delegate
+            // sees our registration, or we see its sent here
+            if (child->sent.load() < my_child_from)
+                return true;
+            orphan = my_child_from;
+            if (child->orphan.compare_exchange_strong(orphan, -1))
+                return false;
+            // A delegate adopted us; our batch is on its way without us
+            return child->sent.load() <= my_child_from;
         }
 
     public:
@@ -112,28 +149,7 @@ namespace CONFIGURED_AGG_FUNNEL
                 aux_data[i].rand.seed = time_seed * 100 + i;
             }
 
-#ifdef DIRECT_COUNT
-            int direct = DIRECT_COUNT;
-#else
-            int direct = 0;
-#endif
-
-#if defined(AGG_COUNT) && AGG_COUNT > 0
-            int fanout = AGG_COUNT;
-#else
-            int fanout = 1;
-#endif
-
-#ifdef USE_ROOT_AGGS
-            std::cout << "Using root stump with direct=" << direct << std::endl;
-            configure_root_fanout(direct);
-#elif defined USE_FIXED_AGGS
-            std::cout << "Using fixed stump with fanout=" << fanout << " and direct=" << direct << std::endl;
-            configure_fixed_fanout(fanout, direct);
-#else
-            std::cout << "(DEFAULT) Using fixed stump with fanout=" << 6 << " and direct=" << 0 << std::endl;
-            configure_fixed_fanout(6, 0);
-#endif
+            FUNNEL_STUMP::configure_from_build(starting_node);
 
             for (int i = 0; i < thread_count; i++)
             {
@@ -143,54 +159,65 @@ namespace CONFIGURED_AGG_FUNNEL
 
         long long max_access() const
         {
-            long long root_access = 0;
-            long long node_access[64] = {};
-            for (int i = 0; i < thread_count; i++)
-            {
-                root_access += aux_data[i].root_access;
-                for (int j = 0; j < 64; j++)
-                    node_access[j] += aux_data[i].access_count[j];
-            }
-            long long max_access = root_access;
-            for (int i = 0; i < 64; i++)
-                max_access = std::max(max_access, node_access[i]);
-            return max_access;
+            return FUNNEL_STUMP::max_access(aux_data);
         }
         long long root_access() const
         {
-            long long root_access = 0;
-            for (int i = 0; i < thread_count; i++)
-                root_access += aux_data[i].root_access;
-            return root_access;
+            return FUNNEL_STUMP::root_access(aux_data);
         }
         void update_aux_data(int thread_id, RunResult &result) const
         {
             result.loop_count_1 += aux_data[thread_id].loop_count_1;
             result.loop_count_2 += aux_data[thread_id].loop_count_2;
             result.root_access += aux_data[thread_id].root_access;
+            result.fallback_count += aux_data[thread_id].fallback_count;
         }
 
-        T update(Node *child, T child_from, T child_to, int thread_id)
+        T update(Node *child, T child_from, T child_to, int thread_id, bool timed)
         {
-            T root_from = counter.fetch_add(child_to - child_from);
+            T root_from = counter.fetch_add(child_to - child_from, FUNNEL_RELAXED);
             // MappingListNode *new_mapping = new MappingListNode();
             MappingListNode *new_mapping = ebr->get_new(thread_id);
 
-            MappingListNode *existing_mapping = child->mapping_list.load();
+            MappingListNode *existing_mapping = child->mapping_list.load(FUNNEL_RELAXED);
             new_mapping->prev = existing_mapping;
             new_mapping->child_from = child_from;
             new_mapping->child_to = child_to;
             new_mapping->root_from = root_from;
             child->mapping_list.store(new_mapping, std::memory_order_release);
-            child->sent.store(child_to, std::memory_order_release);
+            // In timed mode seq_cst pairs with the orphan registration in leave
+            child->sent.store(child_to, timed ? std::memory_order_seq_cst : std::memory_order_release);
 
             ebr->retire(existing_mapping, thread_id);
             return root_from;
         }
 
+        // Called by a delegate right after it published sent = child_from. If the
+        // waiter at child_from left (see try_fetch_add), nobody else will start
+        // that batch, so the delegate sends it on its behalf.
+        void adopt_orphans(Node *child, T child_from, int thread_id)
+        {
+            T orphan = child->orphan.load();
+            while (orphan != -1 && orphan <= child_from)
+            {
+                if (!child->orphan.compare_exchange_strong(orphan, -1))
+                    continue;
+                if (orphan < child_from)
+                    break; // stale, that waiter was in the middle of an earlier batch
+
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                update(child, child_from, child_to, thread_id, true);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].root_access++;
+#endif
+                child_from = child_to;
+                orphan = child->orphan.load();
+            }
+        }
+
         T get_my_root(Node *child, T my_child_from, int thread_id)
         {
-            MappingListNode *mapping = child->mapping_list.load();
+            MappingListNode *mapping = child->mapping_list.load(FUNNEL_ACQUIRE);
             while (mapping->child_from > my_child_from)
             {
 #if defined(AUX_DATA) && AUX_DATA != 0
@@ -212,31 +239,34 @@ namespace CONFIGURED_AGG_FUNNEL
 #if defined(AUX_DATA) && AUX_DATA != 0
                 aux_data[thread_id].root_access++;
 #endif
-                return counter.fetch_add(diff);
+                return counter.fetch_add(diff, FUNNEL_RELAXED);
             }
             ebr->enterCritical(thread_id);
 
             Node *child = &this->child[nd_idx];
-            T child_from = child->count.fetch_add(diff);
-            T next_from = child->sent.load();
+            T child_from = child->count.fetch_add(diff, FUNNEL_RELAXED);
+            T next_from = child->sent.load(FUNNEL_ACQUIRE);
             while (next_from < child_from)
             {
 #if defined(AUX_DATA) && AUX_DATA != 0
                 aux_data[thread_id].loop_count_1++;
 #endif
-                next_from = child->sent.load();
+                next_from = child->sent.load(FUNNEL_ACQUIRE);
             }
 
             T root_from;
             if (child_from == next_from)
             {
                 // I should do the work
-                T child_to = child->count.load();
-                root_from = update(child, child_from, child_to, thread_id);
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                bool timed = timed_mode.delegates_adopt();
+                root_from = update(child, child_from, child_to, thread_id, timed);
 #if defined(AUX_DATA) && AUX_DATA != 0
                 aux_data[thread_id].access_count[nd_idx]++;
                 aux_data[thread_id].root_access++;
 #endif
+                if (timed)
+                    adopt_orphans(child, child_to, thread_id);
             }
             else
             {
@@ -250,9 +280,80 @@ namespace CONFIGURED_AGG_FUNNEL
             return root_from;
         }
 
+        // Same as fetch_add, but gives up waiting once the deadline has passed.
+        // Returns true and sets result if the operation completed in time.
+        //
+        // A waiter that times out leaves its diff in the aggregator and returns
+        // false: the increment is still applied exactly once, by the batch that
+        // eventually covers it, but its return value is lost. A waiter may only
+        // leave while its batch has not started; if it would have been the
+        // delegate, it registers itself as the node's orphan and the previous
+        // delegate starts the batch instead. Only one orphan per node can be
+        // pending at a time, so another waiter on that node keeps waiting past
+        // its deadline, and so does every waiter until timed_mode is on.
+        //
+        // After a timeout the thread's next BYPASS_STEPS calls, and any call whose
+        // deadline has already passed, fall back to a direct FAA on the root.
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            int nd_idx = starting_node[thread_id];
+            if (nd_idx < 0 || aux_data[thread_id].bypass_left > 0 || std::chrono::steady_clock::now() >= deadline)
+            {
+                if (aux_data[thread_id].bypass_left > 0)
+                    aux_data[thread_id].bypass_left--;
+#if defined(AUX_DATA) && AUX_DATA != 0
+                if (nd_idx >= 0)
+                    aux_data[thread_id].fallback_count++;
+                aux_data[thread_id].root_access++;
+#endif
+                result = counter.fetch_add(diff, FUNNEL_RELAXED);
+                return true;
+            }
+            timed_mode.enable(ebr);
+            ebr->enterCritical(thread_id);
+
+            Node *child = &this->child[nd_idx];
+            T child_from = child->count.fetch_add(diff, FUNNEL_RELAXED);
+            T next_from = child->sent.load(FUNNEL_ACQUIRE);
+            int steps = 0;
+            while (next_from < child_from)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                if (++steps % DEADLINE_CHECK_STEPS == 0 && std::chrono::steady_clock::now() >= deadline && timed_mode.waiters_may_leave() && leave(child, child_from))
+                {
+                    aux_data[thread_id].bypass_left = BYPASS_STEPS;
+                    ebr->exitCritical(thread_id);
+                    return false;
+                }
+                next_from = child->sent.load(FUNNEL_ACQUIRE);
+            }
+
+            if (child_from == next_from)
+            {
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                result = update(child, child_from, child_to, thread_id, true);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].access_count[nd_idx]++;
+                aux_data[thread_id].root_access++;
+#endif
+                adopt_orphans(child, child_to, thread_id);
+            }
+            else
+            {
+                result = get_my_root(child, child_from, thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].access_count[nd_idx]++;
+#endif
+            }
+            ebr->exitCritical(thread_id);
+            return true;
+        }
+
         T load() const
         {
-            return counter.load();
+            return counter.load(FUNNEL_ACQUIRE);
         }
 
         void store(T value, std::memory_order order = std::memory_order_seq_cst)
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// Flat combining (Hendler, Incze, Shavit, Tzafrir) as a fetch_add baseline.
+// Every thread owns a padded publication record. To add, it publishes its
+// diff and then either takes the combiner lock or waits for a combiner to
+// serve it. The combiner claims every pending record, applies their sum with
+// one fetch_add on the counter and writes back the individual results.
+//
+// Since the combiner uses fetch_add, load, store and compare_exchange stay
+// plain atomics on the counter that need no lock.
+namespace FLAT_COMBINING
+{
+    struct alignas(512) ThreadLocalData
+    {
+        long long root_access = 0; // combining passes
+        long long loop_count_1 = 0;
+        long long fallback_count = 0;
+    };
+
+    template <typename T>
+    class alignas(1024) FlatCombiningCounter : public Counter<T>
+    {
+    private:
+        static const int IDLE = 0, PENDING = 1, CLAIMED = 2;
+        // try_fetch_add polls the clock once every this many spins
+        static const int DEADLINE_CHECK_STEPS = 64;
+
+        struct alignas(128) PublicationRecord
+        {
+            std::atomic<int> state = IDLE;
+            T diff = 0;
+            T result = 0;
+        };
+
+        alignas(1024) std::atomic<T> counter = 0;
+        int PADDING_1[32] = {};
+
+        alignas(128) std::atomic<bool> combiner_lock = false;
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<PublicationRecord> records;
+        std::vector<ThreadLocalData> aux_data;
+        int PADDING_3[32] = {};
+
+        bool try_lock()
+        {
+            return !combiner_lock.load() && !combiner_lock.exchange(true);
+        }
+
+        void combine(int thread_id)
+        {
+            T sum = 0;
+            for (int i = 0; i < thread_count; i++)
+            {
+                int expected = PENDING;
+                if (records[i].state.load() == PENDING && records[i].state.compare_exchange_strong(expected, CLAIMED))
+                    sum += records[i].diff;
+            }
+            T at = counter.fetch_add(sum);
+            for (int i = 0; i < thread_count; i++)
+            {
+                if (records[i].state.load() != CLAIMED)
+                    continue;
+                records[i].result = at;
+                at += records[i].diff;
+                records[i].state.store(IDLE);
+            }
+            combiner_lock.store(false);
+#if defined(AUX_DATA) && AUX_DATA != 0
+            aux_data[thread_id].root_access++;
+#endif
+        }
+
+    public:
+        FlatCombiningCounter(int thread_count) : FlatCombiningCounter(0, thread_count) {}
+        FlatCombiningCounter(T start, int thread_count)
+            : counter(start), thread_count(thread_count), records(thread_count), aux_data(thread_count) {}
+
+        long long max_access() const
+        {
+            return root_access();
+        }
+        long long root_access() const
+        {
+            long long root_access = 0;
+            for (int i = 0; i < thread_count; i++)
+                root_access += aux_data[i].root_access;
+            return root_access;
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.root_access += aux_data[thread_id].root_access;
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.fallback_count += aux_data[thread_id].fallback_count;
+        }
+
+        T fetch_add(T diff, int thread_id)
+        {
+            PublicationRecord &record = records[thread_id];
+            record.diff = diff;
+            record.state.store(PENDING);
+            while (record.state.load() != IDLE)
+            {
+                if (try_lock())
+                    combine(thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                else
+                    aux_data[thread_id].loop_count_1++;
+#endif
+            }
+            return record.result;
+        }
+
+        // A record that no combiner has claimed yet can be taken back; after a
+        // timeout the thread adds to the counter directly, so it always succeeds
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            PublicationRecord &record = records[thread_id];
+            record.diff = diff;
+            record.state.store(PENDING);
+            int steps = 0;
+            while (record.state.load() != IDLE)
+            {
+                if (try_lock())
+                    combine(thread_id);
+                else if (++steps % DEADLINE_CHECK_STEPS == 0 && std::chrono::steady_clock::now() >= deadline)
+                {
+                    int expected = PENDING;
+                    if (record.state.compare_exchange_strong(expected, IDLE))
+                    {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                        aux_data[thread_id].fallback_count++;
+                        aux_data[thread_id].root_access++;
+#endif
+                        result = counter.fetch_add(diff);
+                        return true;
+                    }
+                }
+            }
+            result = record.result;
+            return true;
+        }
+
+        T load() const
+        {
+            return counter.load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            counter.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return counter.compare_exchange_strong(expected, desired);
+        }
+    };
+}
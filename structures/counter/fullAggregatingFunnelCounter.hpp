@@ -14,6 +14,12 @@
 #define FIXED_AGG_COUNT 6
 #define REP_MAX 1LL << 60
 
+// How long a delegate waits at its exchanger for an opposite batch; 0 turns
+// elimination off
+#ifndef ELIMINATION_SPINS
+#define ELIMINATION_SPINS 64
+#endif
+
 namespace FULL_AGG_FUNNEL
 {
     template <typename T>
@@ -47,13 +53,36 @@ namespace FULL_AGG_FUNNEL
             };
         };
 
+        // Elimination: the delegates of aggs[0][i] and aggs[1][i] can meet at
+        // exchangers[i]. One offers its batch, the other claims it and applies
+        // both with a single root fetch_add of the difference, or only a load
+        // when they cancel. Both batches linearize at that root access, the
+        // positive one first. A delegate only offers while the opposite
+        // aggregator has a batch forming.
+        static const int EMPTY = 0;
+        static const int OFFERED = 1; // + nd_sg
+        static const int BUSY = 3;
+        struct alignas(128) Offer
+        {
+            T amount = 0;
+            T root_from = 0;
+            std::atomic<bool> done = false;
+        };
+        struct alignas(128) Exchanger
+        {
+            std::atomic<int> slot = EMPTY;
+            Offer offers[2];
+        };
+
         alignas(1024) std::atomic<T> counter = 0;
         Node *aggs[2][FIXED_AGG_COUNT];
         int PADDING[32] = {};
+        Exchanger exchangers[FIXED_AGG_COUNT];
 
-    public:
-        inline static EpochBasedReclamation<MappingListNode> *ebr = new EpochBasedReclamation<MappingListNode>(max_thread_count);
+        EpochBasedReclamation<MappingListNode> *ebr = nullptr;
+        int PADDING_2[32] = {};
 
+    public:
         FullAggFunnelCounter() {}
         ~FullAggFunnelCounter()
         {
@@ -72,8 +101,7 @@ namespace FULL_AGG_FUNNEL
         void init(T start, int thread_count)
         {
             counter.store(start);
-            if (thread_count > ebr->thread_count)
-                ebr = new EpochBasedReclamation<MappingListNode>(thread_count);
+            ebr = new EpochBasedReclamation<MappingListNode>(thread_count);
             for (int i = 0; i < FIXED_AGG_COUNT; i++)
             {
                 aggs[0][i] = new Node();
@@ -81,9 +109,51 @@ namespace FULL_AGG_FUNNEL
             }
         }
 
-        T update(Node *child, int sign, T child_from, T child_to, int thread_id)
+        // Value of the root just before this batch of amount (> 0) in the
+        // linearization order
+        T root_fetch_add(int nd_idx, int nd_sg, T amount)
         {
-            T root_from = counter.fetch_add(sign * (child_to - child_from));
+#if ELIMINATION_SPINS > 0
+            Exchanger &exchanger = exchangers[nd_idx];
+            int seen = exchanger.slot.load();
+            if (seen == OFFERED + 1 - nd_sg && exchanger.slot.compare_exchange_strong(seen, BUSY))
+            {
+                Offer &offer = exchanger.offers[1 - nd_sg];
+                T plus = nd_sg == 0 ? amount : offer.amount;
+                T minus = nd_sg == 0 ? offer.amount : amount;
+                T root_from = plus == minus ? counter.load() : counter.fetch_add(plus - minus);
+                offer.root_from = nd_sg == 0 ? root_from + plus : root_from;
+                offer.done.store(true);
+                exchanger.slot.store(EMPTY);
+                return nd_sg == 0 ? root_from : root_from + plus;
+            }
+            Node *opposite = aggs[1 - nd_sg][nd_idx];
+            if (seen == EMPTY && opposite->count.load() > opposite->sent.load())
+            {
+                Offer &mine = exchanger.offers[nd_sg];
+                mine.amount = amount;
+                if (exchanger.slot.compare_exchange_strong(seen, OFFERED + nd_sg))
+                {
+                    for (int i = 0; i < ELIMINATION_SPINS && !mine.done.load(); i++)
+                        ;
+                    int offered = OFFERED + nd_sg;
+                    if (mine.done.load() || !exchanger.slot.compare_exchange_strong(offered, EMPTY))
+                    {
+                        // claimed: the claimer is about to publish my root_from
+                        while (!mine.done.load())
+                            ;
+                        mine.done.store(false, std::memory_order_relaxed);
+                        return mine.root_from;
+                    }
+                }
+            }
+#endif
+            return counter.fetch_add(nd_sg == 0 ? amount : -amount);
+        }
+
+        T update(Node *child, int nd_idx, int nd_sg, T child_from, T child_to, int thread_id)
+        {
+            T root_from = root_fetch_add(nd_idx, nd_sg, child_to - child_from);
             // MappingListNode *new_mapping = new MappingListNode();
             MappingListNode *new_mapping = ebr->get_new(thread_id);
 
@@ -147,7 +217,7 @@ namespace FULL_AGG_FUNNEL
             {
                 // I should do the work
                 T child_to = child->count.load();
-                root_from = update(child, sign, child_from, child_to, thread_id);
+                root_from = update(child, nd_idx, nd_sg, child_from, child_to, thread_id);
                 if (child_to >= REP_MAX)
                 {
                     // create a new aggregator
@@ -171,6 +241,17 @@ namespace FULL_AGG_FUNNEL
             return root_from;
         }
 
+        // Only the entry fallback is supported here: a waiter cannot leave, since
+        // its position may move to a successor aggregator while it waits.
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+                result = counter.fetch_add(diff);
+            else
+                result = fetch_add(diff, thread_id);
+            return true;
+        }
+
         T load() const
         {
             return counter.load();
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// The aggregators of ConfiguredAggFunnelCounter in front of a std::atomic<T>
+// that someone else owns, in the spirit of std::atomic_ref. The word stays
+// where it is, and code that does not know about the funnel keeps using it:
+// loads, stores and RMWs on the word itself are all fine. Only the hot
+// writers call FunnelRef::fetch_add.
+//
+// Mixing is safe because a batch reaches the word with a single fetch_add, so
+// it takes a contiguous range of the word's modification order. A funnel
+// fetch_add linearizes at that RMW like in the other funnels, and a direct
+// RMW linearizes where it is. Funnel diffs must be positive; direct writers
+// may do anything.
+//
+// The word must outlive the FunnelRef. Several FunnelRefs may front the same
+// word, each with its own thread ids.
+namespace FUNNEL_REF
+{
+    struct alignas(512) ThreadLocalData
+    {
+        long long root_access = 0;
+        long long loop_count_1 = 0;
+        long long loop_count_2 = 0;
+    };
+
+    template <typename T>
+    class alignas(1024) FunnelRef : public Counter<T>
+    {
+    private:
+        struct alignas(32) MappingListNode
+        {
+            MappingListNode *prev = nullptr;
+            T child_from = 0;
+            T child_to = 0;
+            T root_from = -1;
+        };
+
+        struct alignas(1024) Node
+        {
+            alignas(128) std::atomic<T> count = 0;
+            alignas(128) std::atomic<T> sent = 0;
+            std::atomic<MappingListNode *> mapping_list = new MappingListNode();
+            ~Node() { delete mapping_list.load(); }
+        };
+
+        std::atomic<T> *word;
+        int PADDING_1[32] = {};
+
+        std::vector<Node> child;
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<ThreadLocalData> aux_data;
+        EpochBasedReclamation<MappingListNode> *ebr = nullptr;
+        int PADDING_3[32] = {};
+
+        T update(Node *node, T child_from, T child_to, int thread_id)
+        {
+            T root_from = word->fetch_add(child_to - child_from);
+            MappingListNode *new_mapping = ebr->get_new(thread_id);
+
+            MappingListNode *existing_mapping = node->mapping_list.load();
+            new_mapping->prev = existing_mapping;
+            new_mapping->child_from = child_from;
+            new_mapping->child_to = child_to;
+            new_mapping->root_from = root_from;
+            node->mapping_list.store(new_mapping);
+            node->sent.store(child_to);
+
+            ebr->retire(existing_mapping, thread_id);
+            return root_from;
+        }
+
+        T get_my_root(Node *node, T my_child_from, int thread_id)
+        {
+            MappingListNode *mapping = node->mapping_list.load();
+            while (mapping->child_from > my_child_from)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_2++;
+#endif
+                mapping = mapping->prev;
+            }
+            return mapping->root_from + my_child_from - mapping->child_from;
+        }
+
+    public:
+        FunnelRef(std::atomic<T> &word, int thread_count) : FunnelRef(word, thread_count, FUNNEL_STUMP::default_fanout(thread_count)) {}
+        FunnelRef(std::atomic<T> &word, int thread_count, int fanout)
+            : word(&word), child(fanout), thread_count(thread_count), aux_data(thread_count)
+        {
+            if (fanout < 1)
+                throw std::invalid_argument("FunnelRef needs at least one aggregator");
+            ebr = new EpochBasedReclamation<MappingListNode>(thread_count);
+        }
+        ~FunnelRef() { delete ebr; }
+
+        long long root_access() const
+        {
+            return FUNNEL_STUMP::root_access(aux_data);
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.loop_count_2 += aux_data[thread_id].loop_count_2;
+            result.root_access += aux_data[thread_id].root_access;
+        }
+
+        T fetch_add(T diff, int thread_id)
+        {
+            ebr->enterCritical(thread_id);
+            Node *node = &child[thread_id % child.size()];
+            T child_from = node->count.fetch_add(diff);
+            T next_from = node->sent.load();
+            while (next_from < child_from)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                next_from = node->sent.load();
+            }
+
+            T root_from;
+            if (child_from == next_from)
+            {
+                T child_to = node->count.load();
+                root_from = update(node, child_from, child_to, thread_id);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].root_access++;
+#endif
+            }
+            else
+                root_from = get_my_root(node, child_from, thread_id);
+            ebr->exitCritical(thread_id);
+            return root_from;
+        }
+
+        // The rest goes straight to the word
+        T load() const
+        {
+            return word->load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            word->store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return word->compare_exchange_strong(expected, desired);
+        }
+
+        std::atomic<T> &target() const
+        {
+            return *word;
+        }
+    };
+}
@@ -58,6 +58,85 @@ namespace HARDWARE_ATOMIC
             return val.fetch_add(diff);
         }
 
+        // A single hardware FAA never waits on anyone, so the deadline is moot
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            result = fetch_add(diff, thread_id);
+            return true;
+        }
+
+        T load() const
+        {
+            return val.load();
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            val.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return val.compare_exchange_strong(expected, desired);
+        }
+    };
+}
+
+namespace HARDWARE_ATOMIC
+{
+    // Baseline for CombinerAggFunnel: every operation is the combiner's RMW on
+    // one atomic (a single instruction for add/or/and/exchange, a CAS loop else)
+    template <typename T, typename Combiner>
+    class alignas(1024) HardwareRMW : public Counter<T>
+    {
+    private:
+        int PADDING_1[32];
+        std::atomic<T> val;
+        int PADDING_2[32];
+        std::vector<ThreadLocalData> aux_data;
+
+    public:
+        HardwareRMW(int thread_count) : HardwareRMW(Combiner::identity(), thread_count) {}
+        HardwareRMW(T start, int thread_count) : val(start)
+        {
+            aux_data.resize(thread_count);
+        }
+
+        long long max_access() const
+        {
+            return root_access();
+        }
+        long long root_access() const
+        {
+            long long access = 0;
+            for (int i = 0; i < aux_data.size(); i++)
+                access += aux_data[i].inc_count;
+            return access;
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.root_access += aux_data[thread_id].inc_count;
+        }
+
+        T fetch_op(T operand, int thread_id)
+        {
+#if defined(AUX_DATA) && AUX_DATA != 0
+            aux_data[thread_id].inc_count++;
+#endif
+            return Combiner::fetch_apply(val, operand);
+        }
+
+        T fetch_add(T diff, int thread_id)
+        {
+            return fetch_op(diff, thread_id);
+        }
+
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            result = fetch_op(diff, thread_id);
+            return true;
+        }
+
         T load() const
         {
             return val.load();
@@ -73,4 +152,59 @@ namespace HARDWARE_ATOMIC
             return val.compare_exchange_strong(expected, desired);
         }
     };
-}
\ No newline at end of file
+}
+
+namespace HARDWARE_ATOMIC
+{
+    // Baseline for KeyedAggFunnel: one unpadded atomic per key
+    template <typename T>
+    class alignas(1024) KeyedHardwareCounter
+    {
+    private:
+        int key_count;
+        std::atomic<T> *counters;
+        int PADDING_1[32];
+        std::vector<ThreadLocalData> aux_data;
+
+    public:
+        KeyedHardwareCounter(int key_count, int thread_count) : key_count(key_count)
+        {
+            counters = new std::atomic<T>[key_count];
+            for (int i = 0; i < key_count; i++)
+                counters[i].store(0, std::memory_order_relaxed);
+            aux_data.resize(thread_count);
+        }
+        ~KeyedHardwareCounter() { delete[] counters; }
+
+        long long max_access() const
+        {
+            return root_access();
+        }
+        long long root_access() const
+        {
+            long long access = 0;
+            for (int i = 0; i < aux_data.size(); i++)
+                access += aux_data[i].inc_count;
+            return access;
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.root_access += aux_data[thread_id].inc_count;
+        }
+
+        int size() const { return key_count; }
+
+        T fetch_add(int key, T diff, int thread_id)
+        {
+#if defined(AUX_DATA) && AUX_DATA != 0
+            aux_data[thread_id].inc_count++;
+#endif
+            return counters[key].fetch_add(diff);
+        }
+
+        T load(int key) const
+        {
+            return counters[key].load();
+        }
+    };
+}
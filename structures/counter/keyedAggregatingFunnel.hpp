@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// Array of counters that share one stump of aggregators, instead of one
+// ConfiguredAggFunnelCounter (and EBR) per key. Roots are plain unpadded
+// atomics, so a key costs 8 bytes.
+//
+// A joiner takes a ticket on its aggregator and writes (key, diff) into slot
+// ticket % SLOT_COUNT. The delegate (ticket == sent) collects tickets
+// [sent, to), at most SLOT_COUNT of them, groups them by key and does one root
+// fetch_add per distinct key. The contributions to one key linearize at that
+// key's root fetch_add in ticket order, so each result is root_from of its key
+// plus the diffs of the same key with smaller tickets. The delegate writes each
+// result back into its slot, and the waiter frees the slot for the next lap.
+//
+// A slot's stamp moves 3t (free for ticket t) -> 3t + 1 (request written)
+// -> 3t + 2 (result written) -> 3(t + SLOT_COUNT) (free again).
+//
+// Each stamp wait depends on one other thread (the joiner, the delegate or the
+// previous user of the slot), so after SPIN_STEPS spins it yields in case that
+// thread is preempted.
+namespace KEYED_AGG_FUNNEL
+{
+    struct alignas(512) ThreadLocalData
+    {
+        long long access_count[64] = {};
+        long long root_access = 0;
+        long long loop_count_1 = 0;
+        long long loop_count_2 = 0;
+    };
+
+    template <typename T>
+    class alignas(1024) KeyedAggFunnel
+    {
+    private:
+        static const int SLOT_COUNT = 64;
+        static const int SPIN_STEPS = 256;
+
+        struct alignas(64) Slot
+        {
+            std::atomic<long long> stamp = 0;
+            int key = 0;
+            T diff = 0;
+            T result = 0;
+        };
+
+        struct alignas(1024) Node
+        {
+            alignas(128) std::atomic<long long> count = 0;
+            alignas(128) std::atomic<long long> sent = 0;
+            alignas(128) Slot slots[SLOT_COUNT];
+            Node()
+            {
+                for (int i = 0; i < SLOT_COUNT; i++)
+                    slots[i].stamp.store(3LL * i);
+            }
+        };
+
+        int key_count;
+        std::atomic<T> *counters;
+        int PADDING_1[32] = {};
+
+        Node child[64];
+        int PADDING_2[32] = {};
+
+        int thread_count;
+        std::vector<int> starting_node;
+        int PADDING_3[32] = {};
+
+        std::vector<ThreadLocalData> aux_data;
+        int PADDING_4[32] = {};
+
+        static void spin(int &steps)
+        {
+            if (++steps > SPIN_STEPS)
+                std::this_thread::yield();
+        }
+
+        void update(Node *child, long long from, int thread_id)
+        {
+            long long to = std::min(child->count.load(), from + SLOT_COUNT);
+            int n = to - from;
+            Slot *batch[SLOT_COUNT];
+            for (int i = 0; i < n; i++)
+            {
+                long long t = from + i;
+                batch[i] = &child->slots[t % SLOT_COUNT];
+                int steps = 0;
+                while (batch[i]->stamp.load(std::memory_order_acquire) != 3 * t + 1)
+                {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                    aux_data[thread_id].loop_count_2++;
+#endif
+                    spin(steps);
+                }
+            }
+
+            // Insertion sort by key: stable, so ticket order is kept within a
+            // key, and it does not allocate like std::stable_sort
+            for (int i = 1; i < n; i++)
+            {
+                Slot *slot = batch[i];
+                int j = i;
+                for (; j > 0 && batch[j - 1]->key > slot->key; j--)
+                    batch[j] = batch[j - 1];
+                batch[j] = slot;
+            }
+            for (int i = 0; i < n;)
+            {
+                int j = i;
+                T sum = 0;
+                for (; j < n && batch[j]->key == batch[i]->key; j++)
+                    sum += batch[j]->diff;
+                T root_from = counters[batch[i]->key].fetch_add(sum);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].root_access++;
+#endif
+                for (; i < j; i++)
+                {
+                    batch[i]->result = root_from;
+                    root_from += batch[i]->diff;
+                }
+            }
+
+            for (long long t = from; t < to; t++)
+            {
+                Slot *slot = &child->slots[t % SLOT_COUNT];
+                slot->stamp.store(3 * t + 2, std::memory_order_release);
+            }
+            child->sent.store(to, std::memory_order_release);
+        }
+
+    public:
+        KeyedAggFunnel(int key_count, int thread_count)
+        {
+            this->key_count = key_count;
+            counters = new std::atomic<T>[key_count];
+            for (int i = 0; i < key_count; i++)
+                counters[i].store(0, std::memory_order_relaxed);
+            this->thread_count = thread_count;
+            starting_node.resize(thread_count, 0);
+            aux_data.resize(thread_count);
+
+            FUNNEL_STUMP::configure_from_build(starting_node);
+        }
+        ~KeyedAggFunnel() { delete[] counters; }
+
+        long long max_access() const
+        {
+            return FUNNEL_STUMP::max_access(aux_data);
+        }
+        long long root_access() const
+        {
+            return FUNNEL_STUMP::root_access(aux_data);
+        }
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.loop_count_2 += aux_data[thread_id].loop_count_2;
+            result.root_access += aux_data[thread_id].root_access;
+        }
+
+        int size() const { return key_count; }
+
+        T fetch_add(int key, T diff, int thread_id)
+        {
+            int nd_idx = starting_node[thread_id];
+            if (nd_idx < 0)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].root_access++;
+#endif
+                return counters[key].fetch_add(diff);
+            }
+
+            Node *child = &this->child[nd_idx];
+            long long ticket = child->count.fetch_add(1);
+#if defined(AUX_DATA) && AUX_DATA != 0
+            aux_data[thread_id].access_count[nd_idx]++;
+#endif
+            Slot *slot = &child->slots[ticket % SLOT_COUNT];
+            int steps = 0;
+            while (slot->stamp.load(std::memory_order_acquire) != 3 * ticket)
+            {
+                // The previous user of my slot has not read its result yet
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                spin(steps);
+            }
+            slot->key = key;
+            slot->diff = diff;
+            slot->stamp.store(3 * ticket + 1, std::memory_order_release);
+
+            steps = 0;
+            while (slot->stamp.load(std::memory_order_acquire) != 3 * ticket + 2)
+            {
+                if (child->sent.load(std::memory_order_acquire) == ticket)
+                {
+                    // I should do the work
+                    update(child, ticket, thread_id);
+                    break;
+                }
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+                spin(steps);
+            }
+            T result = slot->result;
+            slot->stamp.store(3 * (ticket + SLOT_COUNT), std::memory_order_release);
+            return result;
+        }
+
+        T load(int key) const
+        {
+            return counters[key].load();
+        }
+    };
+}
@@ -8,8 +8,16 @@
 #include "./configuredAggregatingFunnelCounter.hpp"
 #include "./hardwareCounter.hpp"
 
+// The outer layer uses the same orderings as ConfiguredAggFunnelCounter; its
+// delegates' "root" RMW is a fetch_add on the inner funnel, which is itself
+// linearizable, so the same argument applies one level up.
 namespace RECURSIVE_AGG_FUNNEL
 {
+    struct alignas(512) ThreadLocalData
+    {
+        long long fallback_count = 0;
+    };
+
     template <typename T>
     class RecursiveAggFunnelCounter : public Counter<T>
     {
@@ -27,9 +35,12 @@ namespace RECURSIVE_AGG_FUNNEL
             alignas(128) std::atomic<T> count = 0;
             alignas(128) std::atomic<T> sent = 0;
             std::atomic<MappingListNode *> mapping_list = new MappingListNode();
+            std::atomic<T> orphan = -1; // position of a waiter that left before its batch started
             ~Node() { delete mapping_list.load(); }
         };
 
+        static const int DEADLINE_CHECK_STEPS = 64;
+
         alignas(1024) CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<T> main_counter;
         int PADDING_1[32] = {};
 
@@ -40,19 +51,13 @@ namespace RECURSIVE_AGG_FUNNEL
         std::vector<int> starting_node;
         int PADDING_3[32] = {};
 
+        std::vector<ThreadLocalData> aux_data;
         EpochBasedReclamation<MappingListNode> *ebr = nullptr;
         int PADDING_4[32] = {};
 
+        TimedMode timed_mode;
+
     public:
-        int configure_fixed_fanout(int fanout)
-        {
-            int root_fanout = fanout;
-            for (int i = 0; i < thread_count; i++)
-            {
-                starting_node[i] = i % fanout + 1;
-            }
-            return root_fanout;
-        }
         RecursiveAggFunnelCounter(int thread_count) : RecursiveAggFunnelCounter(0, thread_count) {}
         ~RecursiveAggFunnelCounter() { delete ebr; }
         RecursiveAggFunnelCounter(T start, int thread_count)
@@ -60,8 +65,9 @@ namespace RECURSIVE_AGG_FUNNEL
             this->thread_count = thread_count;
             ebr = new EpochBasedReclamation<MappingListNode>(thread_count);
             starting_node.resize(thread_count, 0);
+            aux_data.resize(thread_count);
             int my_fanout = (thread_count + 5) / 6; // ceil(thread_count / 6)
-            configure_fixed_fanout(my_fanout);
+            FUNNEL_STUMP::configure_fixed_fanout(starting_node, my_fanout);
             main_counter.init(start, my_fanout);
             for (int i = 0; i < thread_count; i++)
             {
@@ -81,31 +87,68 @@ namespace RECURSIVE_AGG_FUNNEL
         }
         void update_aux_data(int thread_id, RunResult &result) const
         {
-            // throw std::runtime_error("Not implemented");
-            return;
+            result.fallback_count += aux_data[thread_id].fallback_count;
         }
 
-        T update(int nd_idx, T child_from, T child_to, int thread_id)
+        T update(int nd_idx, T child_from, T child_to, int thread_id, bool timed)
         {
             Node *child = &this->child[nd_idx];
             T root_from = main_counter.fetch_add(child_to - child_from, nd_idx - 1);
 
             // MappingListNode *new_mapping = new MappingListNode();
             MappingListNode *new_mapping = ebr->get_new(thread_id);
-            new_mapping->prev = child->mapping_list.load();
+            new_mapping->prev = child->mapping_list.load(FUNNEL_RELAXED);
             new_mapping->child_from = child_from;
             new_mapping->child_to = child_to;
             new_mapping->root_from = root_from;
             child->mapping_list.store(new_mapping, std::memory_order_release);
-            child->sent.store(child_to, std::memory_order_release);
+            // In timed mode seq_cst pairs with the orphan registration in leave
+            child->sent.store(child_to, timed ? std::memory_order_seq_cst : std::memory_order_release);
 
             ebr->retire(new_mapping->prev, thread_id);
             return root_from;
         }
 
+        // See ConfiguredAggFunnelCounter::adopt_orphans
+        void adopt_orphans(int nd_idx, T child_from, int thread_id)
+        {
+            Node *child = &this->child[nd_idx];
+            T orphan = child->orphan.load();
+            while (orphan != -1 && orphan <= child_from)
+            {
+                if (!child->orphan.compare_exchange_strong(orphan, -1))
+                    continue;
+                if (orphan < child_from)
+                    break;
+
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                update(nd_idx, child_from, child_to, thread_id, true);
+                child_from = child_to;
+                orphan = child->orphan.load();
+            }
+        }
+
+        // See ConfiguredAggFunnelCounter::leave
+        bool leave(Node *child, T my_child_from)
+        {
+            T orphan = child->orphan.load();
+            if (orphan != -1 && orphan < child->sent.load())
+                child->orphan.compare_exchange_strong(orphan, -1);
+            orphan = -1;
+            if (!child->orphan.compare_exchange_strong(orphan, my_child_from))
+                return false;
+
+            if (child->sent.load() < my_child_from)
+                return true;
+            orphan = my_child_from;
+            if (child->orphan.compare_exchange_strong(orphan, -1))
+                return false;
+            return child->sent.load() <= my_child_from;
+        }
+
         T get_my_root(Node *child, T my_child_from)
         {
-            MappingListNode *mapping = child->mapping_list.load();
+            MappingListNode *mapping = child->mapping_list.load(FUNNEL_ACQUIRE);
             while (mapping->child_from > my_child_from)
                 mapping = mapping->prev;
 
@@ -120,17 +163,20 @@ namespace RECURSIVE_AGG_FUNNEL
             ebr->enterCritical(thread_id);
 
             Node *child = &this->child[nd_idx];
-            T child_from = child->count.fetch_add(diff);
-            T next_from = child->sent.load();
+            T child_from = child->count.fetch_add(diff, FUNNEL_RELAXED);
+            T next_from = child->sent.load(FUNNEL_ACQUIRE);
             while (next_from < child_from)
-                next_from = child->sent.load();
+                next_from = child->sent.load(FUNNEL_ACQUIRE);
 
             T root_from;
             if (child_from == next_from)
             {
                 // I should do the work
-                T child_to = child->count.load();
-                root_from = update(nd_idx, child_from, child_to, thread_id);
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                bool timed = timed_mode.delegates_adopt();
+                root_from = update(nd_idx, child_from, child_to, thread_id, timed);
+                if (timed)
+                    adopt_orphans(nd_idx, child_to, thread_id);
             }
             else
             {
@@ -141,6 +187,53 @@ namespace RECURSIVE_AGG_FUNNEL
             return root_from;
         }
 
+        // Deadline-bounded fetch_add with the same contract as
+        // ConfiguredAggFunnelCounter::try_fetch_add. Only the outer layer can time
+        // out; once a delegate reaches the inner counter it always completes.
+        bool try_fetch_add(T diff, int thread_id, Deadline deadline, T &result)
+        {
+            int nd_idx = starting_node[thread_id];
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                // nd_idx - 1 is the inner id of this node's delegate, so go
+                // around the inner funnel with a CAS on its root instead
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].fallback_count++;
+#endif
+                result = main_counter.load();
+                while (!main_counter.compare_exchange(result, result + diff))
+                    ;
+                return true;
+            }
+            timed_mode.enable(ebr);
+            ebr->enterCritical(thread_id);
+
+            Node *child = &this->child[nd_idx];
+            T child_from = child->count.fetch_add(diff, FUNNEL_RELAXED);
+            T next_from = child->sent.load(FUNNEL_ACQUIRE);
+            int steps = 0;
+            while (next_from < child_from)
+            {
+                if (++steps % DEADLINE_CHECK_STEPS == 0 && std::chrono::steady_clock::now() >= deadline && timed_mode.waiters_may_leave() && leave(child, child_from))
+                {
+                    ebr->exitCritical(thread_id);
+                    return false;
+                }
+                next_from = child->sent.load(FUNNEL_ACQUIRE);
+            }
+
+            if (child_from == next_from)
+            {
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                result = update(nd_idx, child_from, child_to, thread_id, true);
+                adopt_orphans(nd_idx, child_to, thread_id);
+            }
+            else
+                result = get_my_root(child, child_from);
+            ebr->exitCritical(thread_id);
+            return true;
+        }
+
         T load() const
         {
             return main_counter.load();
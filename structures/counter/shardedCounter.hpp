@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// Per-thread sharded counter, the usual answer for write-mostly statistics.
+// add() only touches the caller's own padded shard and returns nothing, so
+// it is not a Counter<T>: there is no fetch_add.
+//
+// Two reads:
+//  - approximate_sum() adds up the shards as they are. It never waits, but
+//    the value it returns may never have been the count at any one time.
+//  - snapshot(thread_id) is linearizable. Each shard is a seqlock with a
+//    single writer, and the reader collects the sequence numbers, then the
+//    values, then the sequence numbers again. If every sequence number was
+//    even and unchanged, no shard moved in between, so the sum was the count
+//    for that whole window. After max_collects failed collects the reader
+//    raises a gate that holds new adds back until it is done, so it always
+//    finishes.
+//
+// The closing store of add() is seq_cst, so an add is seen by every read
+// that starts after it returns. The other orders follow the usual x86 seqlock.
+namespace SHARDED_COUNTER
+{
+    struct alignas(512) ThreadLocalData
+    {
+        std::vector<unsigned long long> seqs; // for snapshot()
+        long long loop_count_1 = 0;           // failed collects
+        long long loop_count_2 = 0;           // adds held at the gate
+        long long fallback_count = 0;         // snapshots that raised the gate
+    };
+
+    template <typename T>
+    class alignas(1024) ShardedCounter
+    {
+    private:
+        struct alignas(128) Shard
+        {
+            std::atomic<unsigned long long> seq = 0; // odd while an add is in progress
+            std::atomic<T> value = 0;
+        };
+
+        alignas(128) std::atomic<int> gate = 0;
+        int PADDING_1[32] = {};
+
+        int thread_count;
+        int max_collects;
+        std::vector<Shard> shards;
+        std::vector<ThreadLocalData> aux_data;
+        int PADDING_2[32] = {};
+
+    public:
+        static const int DEFAULT_MAX_COLLECTS = 8;
+
+        ShardedCounter(int thread_count) : ShardedCounter(0, thread_count) {}
+        ShardedCounter(T start, int thread_count, int max_collects = DEFAULT_MAX_COLLECTS)
+            : thread_count(thread_count), max_collects(max_collects), shards(thread_count), aux_data(thread_count)
+        {
+            shards[0].value.store(start);
+            for (auto &local : aux_data)
+                local.seqs.resize(thread_count);
+        }
+
+        void update_aux_data(int thread_id, RunResult &result) const
+        {
+            result.loop_count_1 += aux_data[thread_id].loop_count_1;
+            result.loop_count_2 += aux_data[thread_id].loop_count_2;
+            result.fallback_count += aux_data[thread_id].fallback_count;
+        }
+
+        void add(T diff, int thread_id)
+        {
+            Shard &shard = shards[thread_id];
+            while (gate.load(std::memory_order_relaxed) != 0)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_2++;
+#endif
+            }
+            unsigned long long seq = shard.seq.load(std::memory_order_relaxed);
+            shard.seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            shard.value.store(shard.value.load(std::memory_order_relaxed) + diff, std::memory_order_relaxed);
+            shard.seq.store(seq + 2);
+        }
+
+        T approximate_sum() const
+        {
+            T sum = 0;
+            for (auto &shard : shards)
+                sum += shard.value.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        T snapshot(int thread_id)
+        {
+            std::vector<unsigned long long> &seqs = aux_data[thread_id].seqs;
+            bool gated = false;
+            for (int collect = 0;; collect++)
+            {
+                if (collect == max_collects)
+                {
+                    gate.fetch_add(1);
+                    gated = true;
+#if defined(AUX_DATA) && AUX_DATA != 0
+                    aux_data[thread_id].fallback_count++;
+#endif
+                }
+                bool clean = true;
+                for (int i = 0; i < thread_count; i++)
+                {
+                    seqs[i] = shards[i].seq.load(std::memory_order_acquire);
+                    clean &= seqs[i] % 2 == 0;
+                }
+                T sum = 0;
+                for (int i = 0; clean && i < thread_count; i++)
+                    sum += shards[i].value.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                for (int i = 0; clean && i < thread_count; i++)
+                    clean = shards[i].seq.load(std::memory_order_relaxed) == seqs[i];
+                if (clean)
+                {
+                    if (gated)
+                        gate.fetch_sub(1);
+                    return sum;
+                }
+#if defined(AUX_DATA) && AUX_DATA != 0
+                aux_data[thread_id].loop_count_1++;
+#endif
+            }
+        }
+    };
+}
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <new>
+#include <thread>
+#include <string>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#ifndef COUNTER_COMMON_HPP
+#define COUNTER_COMMON_HPP
+#include "./common.hpp"
+#endif
+
+// ConfiguredAggFunnelCounter laid out in one shared memory region, so that
+// several processes can use the same funnel. Nothing in the region is a
+// pointer: mapping list links are indexes into an in-region pool of
+// MappingListNodes, and the EBR state (global epoch, announcements, retire
+// bags) lives in the region too. Each process maps the region wherever it
+// likes and holds a SharedFunnelCounter handle on it.
+//
+// Threads take part through slots. register_slot() hands the calling thread a
+// free slot, which is its thread_id for fetch_add. Each slot owns a share of
+// the pool as a private free list: a delegate takes one node from it and
+// retires the old list head into its own bags, so a slot's share never runs
+// dry while the epoch advances. If it does (a slot stays announced, e.g. its
+// process died inside fetch_add), the slot falls back to a direct FAA on the
+// root. A process that dies as a delegate still blocks its aggregator.
+//
+// The region must start zero-filled (a fresh MAP_ANONYMOUS or shm_open
+// mapping is). The first handle on it initializes it, later ones attach.
+namespace SHARED_FUNNEL
+{
+    template <typename T>
+    class SharedFunnelCounter
+    {
+    public:
+        static const int MAX_NODES = 64;
+        static const int POOL_PER_SLOT = 256;
+
+    private:
+        static const uint32_t NIL = 0xffffffff;
+        static const int REFRESH_STEPS = 16;
+        static const uint64_t MAGIC = 0x5348464e4e4c3031; // "SHFNNL01"
+        static const int UNINITIALIZED = 0, INITIALIZING = 1, READY = 2;
+
+        struct MappingListNode
+        {
+            uint32_t prev;
+            uint32_t next; // free list or retire bag
+            T child_from;
+            T child_to;
+            T root_from;
+        };
+
+        struct alignas(128) Node
+        {
+            alignas(128) std::atomic<T> count = 0;
+            alignas(128) std::atomic<T> sent = 0;
+            std::atomic<uint32_t> mapping_list = NIL;
+        };
+
+        struct alignas(256) Slot
+        {
+            alignas(64) std::atomic<long long> announcement = -1;
+            std::atomic<int> owner = 0; // pid, 0 while free
+            int node = 0;
+
+            // Only the owner touches the rest
+            long long epoch = 0;
+            long long retire_count = 0;
+            uint32_t free_list = NIL;
+            uint32_t old_bag = NIL;
+            uint32_t cur_bag = NIL;
+
+            long long root_access = 0;
+            long long loop_count_1 = 0;
+            long long loop_count_2 = 0;
+            long long fallback_count = 0;
+        };
+
+        struct alignas(1024) Header
+        {
+            uint64_t magic;
+            int state; // only accessed through atomic_ref, it is read before the rest exists
+            int slot_count;
+            int fanout;
+            alignas(128) std::atomic<T> counter;
+            alignas(128) std::atomic<long long> current_epoch;
+            alignas(128) Node nodes[MAX_NODES];
+        };
+
+        Header *header = nullptr;
+        Slot *slots = nullptr;
+        MappingListNode *pool = nullptr;
+
+        static std::size_t slots_offset()
+        {
+            return sizeof(Header);
+        }
+        static std::size_t pool_offset(int slot_count)
+        {
+            return slots_offset() + slot_count * sizeof(Slot);
+        }
+
+        void initialize(int slot_count, int fanout, T start)
+        {
+            header->slot_count = slot_count;
+            header->fanout = fanout;
+            new (&header->counter) std::atomic<T>(start);
+            new (&header->current_epoch) std::atomic<long long>(0);
+
+            // Pool entries [0, MAX_NODES) are the initial list heads
+            for (int i = 0; i < MAX_NODES; i++)
+            {
+                new (&header->nodes[i]) Node();
+                pool[i] = {NIL, NIL, 0, 0, -1};
+                header->nodes[i].mapping_list.store(i);
+            }
+            for (int i = 0; i < slot_count; i++)
+            {
+                Slot *slot = new (&slots[i]) Slot();
+                slot->node = i % fanout;
+                uint32_t first = MAX_NODES + i * POOL_PER_SLOT;
+                for (uint32_t j = first; j < first + POOL_PER_SLOT; j++)
+                {
+                    pool[j].next = slot->free_list;
+                    slot->free_list = j;
+                }
+            }
+            header->magic = MAGIC;
+        }
+
+        bool update_global_epoch()
+        {
+            long long current_e = header->current_epoch.load();
+            for (int i = 0; i < header->slot_count; i++)
+            {
+                long long slot_epoch = slots[i].announcement.load();
+                if (slot_epoch != -1 && slot_epoch < current_e)
+                    return false;
+            }
+            return header->current_epoch.compare_exchange_strong(current_e, current_e + 1);
+        }
+
+        // Once the epoch moved past the slot's, nodes in its old bag were
+        // retired two epochs ago and go back to its free list
+        void recycle(Slot &me)
+        {
+            long long current_e = header->current_epoch.load();
+            if (me.epoch >= current_e)
+                return;
+            while (me.old_bag != NIL)
+            {
+                uint32_t node = me.old_bag;
+                me.old_bag = pool[node].next;
+                pool[node].next = me.free_list;
+                me.free_list = node;
+            }
+            me.old_bag = me.cur_bag;
+            me.cur_bag = NIL;
+            me.epoch = current_e;
+        }
+
+        void retire(Slot &me, uint32_t node)
+        {
+            recycle(me);
+            if (++me.retire_count % REFRESH_STEPS == 0)
+                update_global_epoch();
+            pool[node].next = me.cur_bag;
+            me.cur_bag = node;
+        }
+
+        T update(Node *child, T child_from, T child_to, Slot &me)
+        {
+            T root_from = header->counter.fetch_add(child_to - child_from, FUNNEL_RELAXED);
+            uint32_t new_mapping = me.free_list;
+            me.free_list = pool[new_mapping].next;
+
+            uint32_t existing_mapping = child->mapping_list.load(FUNNEL_RELAXED);
+            pool[new_mapping] = {existing_mapping, NIL, child_from, child_to, root_from};
+            child->mapping_list.store(new_mapping, std::memory_order_release);
+            child->sent.store(child_to);
+
+            retire(me, existing_mapping);
+            return root_from;
+        }
+
+        T get_my_root(Node *child, T my_child_from, Slot &me)
+        {
+            MappingListNode *mapping = &pool[child->mapping_list.load(FUNNEL_ACQUIRE)];
+            while (mapping->child_from > my_child_from)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                me.loop_count_2++;
+#endif
+                mapping = &pool[mapping->prev];
+            }
+            return mapping->root_from + my_child_from - mapping->child_from;
+        }
+
+    public:
+        static std::size_t region_bytes(int slot_count)
+        {
+            return pool_offset(slot_count) + (MAX_NODES + (std::size_t)slot_count * POOL_PER_SLOT) * sizeof(MappingListNode);
+        }
+
+        // Zero-filled memory shared with children forked after this call
+        static void *map_anonymous(std::size_t bytes)
+        {
+            void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                throw std::runtime_error("mmap of the shared funnel failed");
+            return memory;
+        }
+
+        // POSIX shared memory object, for unrelated processes. Zero-filled when
+        // this call creates it.
+        static void *map_named(const std::string &name, std::size_t bytes)
+        {
+            int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+            if (fd < 0)
+                throw std::runtime_error("shm_open of " + name + " failed");
+            if (ftruncate(fd, bytes) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("ftruncate of " + name + " failed");
+            }
+            void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (memory == MAP_FAILED)
+                throw std::runtime_error("mmap of " + name + " failed");
+            return memory;
+        }
+
+        static void unmap(void *memory, std::size_t bytes)
+        {
+            munmap(memory, bytes);
+        }
+
+        // Initializes the region at memory, or attaches to it if another handle
+        // already did. slot_count and fanout must match what it was created with.
+        SharedFunnelCounter(void *memory, std::size_t bytes, int slot_count, int fanout, T start = 0)
+        {
+            if (fanout < 1 || fanout > MAX_NODES || slot_count < 1)
+                throw std::invalid_argument("SharedFunnelCounter needs 1 to 64 aggregators and at least one slot");
+            if (bytes < region_bytes(slot_count) || (uintptr_t)memory % alignof(Header) != 0)
+                throw std::invalid_argument("Shared funnel region is too small or misaligned");
+            header = (Header *)memory;
+            slots = (Slot *)((char *)memory + slots_offset());
+            pool = (MappingListNode *)((char *)memory + pool_offset(slot_count));
+
+            std::atomic_ref<int> state(header->state);
+            int expected = UNINITIALIZED;
+            if (state.compare_exchange_strong(expected, INITIALIZING))
+            {
+                initialize(slot_count, fanout, start);
+                state.store(READY, std::memory_order_release);
+            }
+            else
+            {
+                while (state.load(std::memory_order_acquire) != READY)
+                    std::this_thread::yield();
+            }
+            if (header->magic != MAGIC || header->slot_count != slot_count || header->fanout != fanout)
+                throw std::runtime_error("Shared funnel region was created with another layout");
+        }
+
+        int slot_count() const
+        {
+            return header->slot_count;
+        }
+
+        // Claims a free slot for the calling thread of this process
+        int register_slot()
+        {
+            int pid = getpid();
+            for (int i = 0; i < header->slot_count; i++)
+            {
+                int expected = 0;
+                if (slots[i].owner.load() == 0 && slots[i].owner.compare_exchange_strong(expected, pid))
+                    return i;
+            }
+            throw std::runtime_error("No free slot in the shared funnel");
+        }
+
+        // The slot keeps its pool share and bags for its next owner
+        void unregister_slot(int slot)
+        {
+            slots[slot].owner.store(0);
+        }
+
+        // Frees the slots of processes that no longer exist, so their
+        // announcements stop holding back the epoch. Returns how many.
+        int release_dead_slots()
+        {
+            int released = 0;
+            for (int i = 0; i < header->slot_count; i++)
+            {
+                int pid = slots[i].owner.load();
+                if (pid == 0 || kill(pid, 0) == 0 || errno != ESRCH)
+                    continue;
+                slots[i].announcement.store(-1);
+                if (slots[i].owner.compare_exchange_strong(pid, 0))
+                    released++;
+            }
+            return released;
+        }
+
+        long long root_access() const
+        {
+            long long root_access = 0;
+            for (int i = 0; i < header->slot_count; i++)
+                root_access += slots[i].root_access;
+            return root_access;
+        }
+        void update_aux_data(int slot, RunResult &result) const
+        {
+            result.loop_count_1 += slots[slot].loop_count_1;
+            result.loop_count_2 += slots[slot].loop_count_2;
+            result.root_access += slots[slot].root_access;
+            result.fallback_count += slots[slot].fallback_count;
+        }
+
+        T fetch_add(T diff, int slot)
+        {
+            Slot &me = slots[slot];
+            if (me.free_list == NIL)
+            {
+                update_global_epoch();
+                recycle(me);
+            }
+            if (me.free_list == NIL)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                me.fallback_count++;
+                me.root_access++;
+#endif
+                return header->counter.fetch_add(diff, FUNNEL_RELAXED);
+            }
+            me.announcement.exchange(header->current_epoch.load());
+
+            Node *child = &header->nodes[me.node];
+            T child_from = child->count.fetch_add(diff, FUNNEL_RELAXED);
+            T next_from = child->sent.load(FUNNEL_ACQUIRE);
+            while (next_from < child_from)
+            {
+#if defined(AUX_DATA) && AUX_DATA != 0
+                me.loop_count_1++;
+#endif
+                next_from = child->sent.load(FUNNEL_ACQUIRE);
+            }
+
+            T root_from;
+            if (child_from == next_from)
+            {
+                T child_to = child->count.load(FUNNEL_RELAXED);
+                root_from = update(child, child_from, child_to, me);
+#if defined(AUX_DATA) && AUX_DATA != 0
+                me.root_access++;
+#endif
+            }
+            else
+                root_from = get_my_root(child, child_from, me);
+            me.announcement.store(-1, std::memory_order_release);
+            return root_from;
+        }
+
+        T load() const
+        {
+            return header->counter.load(FUNNEL_ACQUIRE);
+        }
+
+        void store(T value, std::memory_order order = std::memory_order_seq_cst)
+        {
+            header->counter.store(value, order);
+        }
+
+        bool compare_exchange(T &expected, T desired)
+        {
+            return header->counter.compare_exchange_strong(expected, desired);
+        }
+    };
+}
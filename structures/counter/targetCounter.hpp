@@ -3,7 +3,11 @@
 #include "./fullAggregatingFunnelCounter.hpp"
 #include "./configuredAggregatingFunnelCounter.hpp"
 #include "./recursiveAggregatingFunnelCounter.hpp"
+#include "./batchRecordAggregatingFunnelCounter.hpp"
+#include "./combinerAggregatingFunnel.hpp"
 #include "./combiningFunnelCounter.hpp"
+#include "./flatCombiningCounter.hpp"
+#include "./combiningTreeCounter.hpp"
 
 #ifdef USE_HARDWARE_COUNTER
 #pragma message("Compiling with HardwareCounter")
@@ -13,6 +17,14 @@ typedef HARDWARE_ATOMIC::HardwareCounter<long long> TargetCounter;
 #pragma message("Compiling with CombiningFunnelCounter")
 typedef COMB_FUNNEL::CombiningFunnelCounter<long long> TargetCounter;
 
+#elif USE_FLAT_COMBINING_COUNTER
+#pragma message("Compiling with FlatCombiningCounter")
+typedef FLAT_COMBINING::FlatCombiningCounter<long long> TargetCounter;
+
+#elif USE_COMBINING_TREE_COUNTER
+#pragma message("Compiling with CombiningTreeCounter")
+typedef COMBINING_TREE::CombiningTreeCounter<long long> TargetCounter;
+
 #elif USE_SIMPLE_AGG_COUNTER
 #pragma message("Compiling with AggFunnelCounter")
 typedef SIMPLE_AGG_FUNNEL::AggFunnelCounter<long long> TargetCounter;
@@ -29,6 +41,24 @@ typedef CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long> TargetCount
 #pragma message("Compiling with RecursiveAggFunnelCounter")
 typedef RECURSIVE_AGG_FUNNEL::RecursiveAggFunnelCounter<long long> TargetCounter;
 
+#elif USE_BATCH_RECORD_AGG_COUNTER
+#pragma message("Compiling with BatchRecordAggFunnelCounter")
+typedef BATCH_RECORD_AGG_FUNNEL::BatchRecordAggFunnelCounter<long long> TargetCounter;
+
+#elif USE_COMBINER_AGG_COUNTER
+#pragma message("Compiling with CombinerAggFunnel")
+#ifndef FUNNEL_COMBINER
+#define FUNNEL_COMBINER AddCombiner
+#endif
+typedef COMBINER_AGG_FUNNEL::CombinerAggFunnel<long long, COMBINERS::FUNNEL_COMBINER<long long>> TargetCounter;
+
+#elif USE_HARDWARE_RMW_COUNTER
+#pragma message("Compiling with HardwareRMW")
+#ifndef FUNNEL_COMBINER
+#define FUNNEL_COMBINER AddCombiner
+#endif
+typedef HARDWARE_ATOMIC::HardwareRMW<long long, COMBINERS::FUNNEL_COMBINER<long long>> TargetCounter;
+
 #elif USE_EMPTY_COUNTER
 #pragma message("Compiling with EmptyCounter")
 typedef EmptyCounter<long long> TargetCounter;
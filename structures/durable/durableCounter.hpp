@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../counter/common.hpp"
+
+// A fetch_add counter whose handed out values survive restarts. Any counter
+// with fetch_add(diff, thread_id) can sit underneath, so a funnel takes the
+// contention as usual. Diffs must be positive.
+//
+// The file holds a high-water mark: every value below it may have been handed
+// out, nothing at or above it has. A fetch_add that returns v only returns
+// once the mark is at least v + diff. When it is not, the caller raises the
+// mark to the next multiple of chunk, msyncs the page and publishes the new
+// mark; callers that need the same chunk wait for that one msync instead of
+// doing their own. So one msync covers chunk values, and with a funnel the
+// callers that cross a boundary are mostly delegates, since a batch's values
+// are contiguous and its waiters fall under the mark the delegate raised.
+//
+// Reopening the file resumes the counter at the persisted mark, skipping at
+// most chunk values that were reserved but never handed out.
+namespace DURABLE_COUNTER
+{
+    template <typename Index>
+    class DurableCounter
+    {
+    private:
+        static const uint64_t MAGIC = 0x4455524142434e54; // "DURABCNT"
+        static const long long FILE_BYTES = 4096;
+
+        struct FileHeader
+        {
+            uint64_t magic;
+            long long mark;
+        };
+
+        Index *index;
+        int PADDING_1[32] = {};
+
+        alignas(64) std::atomic<long long> durable = 0; // last mark that reached the disk
+        int PADDING_2[32] = {};
+
+        alignas(64) std::mutex persist_mtx;
+        FileHeader *file = nullptr;
+        long long chunk;
+        long long recovered = 0;
+        long long msync_count = 0;
+        int fd = -1;
+
+        // Raises the mark to cover end
+        void persist(long long end)
+        {
+            std::lock_guard<std::mutex> lock(persist_mtx);
+            if (durable.load() >= end)
+                return;
+            long long mark = (end + chunk - 1) / chunk * chunk;
+            file->mark = mark;
+            if (msync(file, FILE_BYTES, MS_SYNC) != 0)
+                throw std::runtime_error("msync of the durable counter failed");
+            msync_count++;
+            durable.store(mark, std::memory_order_release);
+        }
+
+    public:
+        // Opens or creates the mark file at path
+        DurableCounter(const std::string &path, long long chunk, int thread_count) : chunk(chunk)
+        {
+            if (chunk < 1)
+                throw std::invalid_argument("DurableCounter needs a chunk of at least 1");
+            fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0)
+                throw std::runtime_error("Cannot open " + path);
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (st.st_size < FILE_BYTES && ftruncate(fd, FILE_BYTES) != 0))
+            {
+                close(fd);
+                throw std::runtime_error("Cannot size " + path);
+            }
+            void *memory = mmap(nullptr, FILE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (memory == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            file = (FileHeader *)memory;
+
+            if (file->magic == MAGIC)
+                recovered = file->mark;
+            else if (file->magic != 0)
+            {
+                munmap(file, FILE_BYTES);
+                close(fd);
+                throw std::runtime_error(path + " is not a durable counter file");
+            }
+            else
+            {
+                file->mark = 0;
+                file->magic = MAGIC;
+                if (msync(file, FILE_BYTES, MS_SYNC) != 0)
+                {
+                    munmap(file, FILE_BYTES);
+                    close(fd);
+                    throw std::runtime_error("msync of the durable counter failed");
+                }
+            }
+            durable.store(recovered);
+            index = new Index(thread_count);
+            index->store(recovered);
+        }
+        ~DurableCounter()
+        {
+            delete index;
+            munmap(file, FILE_BYTES);
+            close(fd);
+        }
+
+        long long fetch_add(long long diff, int thread_id)
+        {
+            long long from = index->fetch_add(diff, thread_id);
+            if (from + diff > durable.load(std::memory_order_acquire))
+                persist(from + diff);
+            return from;
+        }
+
+        long long load() const
+        {
+            return index->load();
+        }
+
+        // Where this run started: the mark found in the file
+        long long recovered_from() const
+        {
+            return recovered;
+        }
+
+        long long persisted_mark() const
+        {
+            return durable.load();
+        }
+
+        long long msyncs() const
+        {
+            return msync_count;
+        }
+    };
+}
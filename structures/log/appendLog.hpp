@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../counter/common.hpp"
+#include "../sync/waitPolicy.hpp"
+
+// Append-only log over a ring of fixed-size segments. Writers reserve bytes
+// with tail->fetch_add(record bytes) on any fetch_add counter, so a funnel can
+// take the tail contention; the tail is a byte offset into an endless log and
+// segment s of it lives in buffer s % segment_count.
+//
+// Every record starts with an 8 byte header that doubles as its commit flag:
+// it stays 0 until the writer has copied the payload and then stores
+// (bytes << 2) | pad << 1 | 1. A single reader walks the headers from its head
+// and consumes the contiguous committed prefix. When it leaves a segment it
+// zeroes it and marks it recycled; a writer whose reservation lands in a
+// segment that is still in use one lap behind waits for that.
+//
+// Records never straddle segments: a writer whose reservation crosses the end
+// of one fills its bytes on both sides with pad records and reserves again.
+namespace APPEND_LOG
+{
+    template <typename Index, typename Wait = WAIT_POLICY::SpinWait>
+    class AppendLog
+    {
+    public:
+        static const long long HEADER_BYTES = 8;
+
+        struct Reservation
+        {
+            long long offset; // of the header in the log
+            char *payload;
+            uint64_t header;
+        };
+
+    private:
+        Index *tail;
+        int PADDING_1[32] = {};
+
+        long long segment_bytes;
+        long long segment_count;
+        std::vector<uint64_t *> segments;
+        int PADDING_2[32] = {};
+
+        alignas(64) std::atomic<long long> recycled = 0; // segments below this are free again
+        int PADDING_3[32] = {};
+        alignas(64) long long head = 0;                  // only the reader touches it
+        int PADDING_4[32] = {};
+        Wait waiter;
+
+        static long long record_bytes(long long payload_bytes)
+        {
+            return HEADER_BYTES + (payload_bytes + 7) / 8 * 8;
+        }
+
+        uint64_t *at(long long offset) const
+        {
+            long long segment = offset / segment_bytes;
+            return segments[segment % segment_count] + (offset % segment_bytes) / 8;
+        }
+
+        void wait_for_segment(long long segment)
+        {
+            if (segment >= recycled.load() + segment_count)
+                waiter.wait_until([&]()
+                                  { return segment < recycled.load() + segment_count; });
+        }
+
+        void commit_header(long long offset, uint64_t header)
+        {
+            std::atomic_ref<uint64_t>(*at(offset)).store(header, std::memory_order_release);
+        }
+
+        void pad(long long from, long long to)
+        {
+            if (to <= from)
+                return;
+            wait_for_segment(from / segment_bytes);
+            commit_header(from, (uint64_t)(to - from) << 2 | 3);
+        }
+
+    public:
+        AppendLog(long long segment_bytes, long long segment_count, int thread_count)
+            : segment_bytes(segment_bytes / 8 * 8), segment_count(segment_count)
+        {
+            if (this->segment_bytes < 2 * HEADER_BYTES || segment_count < 1)
+                throw std::invalid_argument("AppendLog needs at least one segment of 16 bytes");
+            tail = new Index(thread_count);
+            for (long long i = 0; i < segment_count; i++)
+                segments.push_back(new uint64_t[this->segment_bytes / 8]());
+        }
+        ~AppendLog()
+        {
+            delete tail;
+            for (auto segment : segments)
+                delete[] segment;
+        }
+
+        long long max_payload() const
+        {
+            return segment_bytes - HEADER_BYTES;
+        }
+
+        // Space for payload_bytes, to fill and then commit
+        Reservation reserve(long long payload_bytes, int thread_id)
+        {
+            if (payload_bytes > max_payload())
+                throw std::invalid_argument("Record larger than a segment");
+            long long bytes = record_bytes(payload_bytes);
+            while (true)
+            {
+                long long offset = tail->fetch_add(bytes, thread_id);
+                long long boundary = (offset / segment_bytes + 1) * segment_bytes;
+                if (offset + bytes <= boundary)
+                {
+                    wait_for_segment(offset / segment_bytes);
+                    return {offset, (char *)(at(offset) + 1), (uint64_t)bytes << 2 | 1};
+                }
+                pad(offset, boundary);
+                pad(boundary, offset + bytes);
+            }
+        }
+
+        void commit(const Reservation &reservation)
+        {
+            commit_header(reservation.offset, reservation.header);
+        }
+
+        // Returns the offset of the record
+        long long append(const void *data, long long payload_bytes, int thread_id)
+        {
+            Reservation reservation = reserve(payload_bytes, thread_id);
+            std::memcpy(reservation.payload, data, payload_bytes);
+            commit(reservation);
+            return reservation.offset;
+        }
+
+        // Single reader: calls f(payload, payload_bytes, offset) for every
+        // committed record from the head up to the first uncommitted one and
+        // returns how many it consumed. payload_bytes is rounded up to 8.
+        template <typename F>
+        long long consume(F f)
+        {
+            long long consumed = 0;
+            while (true)
+            {
+                uint64_t header = std::atomic_ref<uint64_t>(*at(head)).load(std::memory_order_acquire);
+                if (header == 0)
+                    return consumed;
+                long long bytes = header >> 2;
+                if ((header & 2) == 0)
+                {
+                    f((const char *)(at(head) + 1), bytes - HEADER_BYTES, head);
+                    consumed++;
+                }
+                head += bytes;
+                if (head % segment_bytes == 0)
+                {
+                    long long segment = head / segment_bytes - 1;
+                    std::memset(segments[segment % segment_count], 0, segment_bytes);
+                    recycled.store(segment + 1);
+                    waiter.notify_all();
+                }
+            }
+        }
+
+        // Everything below is consumed
+        long long committed_prefix() const
+        {
+            return head;
+        }
+
+        long long reserved() const
+        {
+            return tail->load();
+        }
+    };
+}
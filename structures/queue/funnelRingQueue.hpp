@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../counter/common.hpp"
+
+// MPMC ring queue whose head and tail are fetch_add counters, so the only
+// contended RMWs are the two index fetch_adds and Index can be any of the
+// funnel counters (or HardwareCounter as the baseline).
+//
+// Like the CRQ ring of LCRQ, ticket t owns cell t % capacity in lap
+// t / capacity. Each cell has a turn that goes through three values per lap:
+// FREE while it waits for the lap's enqueuer, WRITING while that enqueuer
+// writes and FULL while the value waits for the lap's dequeuer, who then
+// moves it to the next lap's FREE.
+//
+// As in CRQ, a dequeuer whose cell is still FREE and whose ticket is not
+// below tail finds the queue empty. It moves the cell to the next lap
+// itself, and the enqueuer that later gets the same ticket fails to claim
+// the cell and takes a new ticket. Unlike CRQ there is no ring closing (that
+// needs a fetch_or on tail, which the funnels don't have), so an enqueue
+// waits while its cell still holds the previous lap's value: the queue is
+// bounded.
+namespace FUNNEL_RING_QUEUE
+{
+    template <typename T, typename Index>
+    class alignas(1024) RingQueue
+    {
+    private:
+        static const int FREE = 0, WRITING = 1, FULL = 2, TURNS = 3;
+
+        struct alignas(64) Cell
+        {
+            std::atomic<long long> turn = 0;
+            T value;
+        };
+
+        Index *head;
+        int PADDING_1[32] = {};
+        Index *tail;
+        int PADDING_2[32] = {};
+
+        long long capacity;
+        std::vector<Cell> cells;
+
+        // A full or empty queue can keep a thread waiting indefinitely, so unlike
+        // the funnels' waits this one yields once it has spun for a while
+        static const int SPIN_STEPS = 1024;
+
+        static void backoff(int &steps)
+        {
+            if (++steps >= SPIN_STEPS)
+                std::this_thread::yield();
+        }
+
+    public:
+        RingQueue(long long capacity, int thread_count) : capacity(capacity), cells(capacity)
+        {
+            head = new Index(thread_count);
+            tail = new Index(thread_count);
+        }
+        ~RingQueue()
+        {
+            delete head;
+            delete tail;
+        }
+
+        void enqueue(T value, int thread_id)
+        {
+            int steps = 0;
+            while (true)
+            {
+                long long ticket = tail->fetch_add(1, thread_id);
+                Cell *cell = &cells[ticket % capacity];
+                long long lap = TURNS * (ticket / capacity);
+                long long turn = cell->turn.load(std::memory_order_acquire);
+                while (turn < lap + FREE)
+                {
+                    // The previous lap's value has not been dequeued yet
+                    backoff(steps);
+                    turn = cell->turn.load(std::memory_order_acquire);
+                }
+                if (turn == lap + FREE && cell->turn.compare_exchange_strong(turn, lap + WRITING))
+                {
+                    cell->value = value;
+                    cell->turn.store(lap + FULL, std::memory_order_release);
+                    return;
+                }
+                // My dequeuer found the cell empty and skipped this lap
+            }
+        }
+
+        // Returns false if the queue was empty: either head had caught up with
+        // tail, or the ticket taken turned out to have no enqueuer yet
+        bool try_dequeue(T &out, int thread_id)
+        {
+            if (head->load() >= tail->load())
+                return false;
+            long long ticket = head->fetch_add(1, thread_id);
+            Cell *cell = &cells[ticket % capacity];
+            long long lap = TURNS * (ticket / capacity);
+            int steps = 0;
+            while (true)
+            {
+                long long turn = cell->turn.load(std::memory_order_acquire);
+                if (turn == lap + FULL)
+                {
+                    out = cell->value;
+                    cell->turn.store(lap + TURNS, std::memory_order_release);
+                    return true;
+                }
+                // An enqueuer with this ticket would have raised tail past it
+                if (turn == lap + FREE && ticket >= tail->load() && cell->turn.compare_exchange_strong(turn, lap + TURNS))
+                    return false;
+                backoff(steps);
+            }
+        }
+
+        // Waits while the queue is empty
+        T dequeue(int thread_id)
+        {
+            T value;
+            int steps = 0;
+            while (!try_dequeue(value, thread_id))
+                backoff(steps);
+            return value;
+        }
+
+        // Enqueues minus dequeues that have taken a ticket, not atomic. Tickets
+        // of dequeues that found the queue empty count too, so head can pass
+        // tail; that reads as 0.
+        long long size() const
+        {
+            return std::max(0LL, tail->load() - head->load());
+        }
+
+        const Index *head_index() const { return head; }
+        const Index *tail_index() const { return tail; }
+    };
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+#include "../counter/common.hpp"
+#include "../sync/waitPolicy.hpp"
+#include "../sync/funnelBarrier.hpp"
+
+// Self-scheduling parallel_for on a pool of persistent workers. Workers draw
+// iteration ranges with index->fetch_add(chunk) on one shared fetch_add
+// counter, so a funnel (or HardwareCounter as the baseline) takes the index
+// contention. The counter is never reset: each loop starts from wherever the
+// last one left it.
+//
+// The chunk size is picked before the fetch_add from a load of the index, so it
+// is based on a slightly stale position; only the size suffers from that, the
+// ranges themselves never overlap:
+//  - FIXED:     always min_chunk
+//  - GUIDED:    remaining / (GUIDED_FACTOR * workers)
+//  - TRAPEZOID: falls linearly from total / (2 * workers) at the start to
+//               min_chunk at the end
+// GUIDED and TRAPEZOID never go below min_chunk.
+namespace CHUNK_SCHEDULER
+{
+    enum Schedule
+    {
+        FIXED,
+        GUIDED,
+        TRAPEZOID
+    };
+
+    template <typename Index, typename Wait = WAIT_POLICY::ParkWait>
+    class ChunkScheduler
+    {
+    private:
+        static const int GUIDED_FACTOR = 2;
+
+        struct alignas(128) WorkerStats
+        {
+            long long chunk_count = 0;
+            long long iteration_count = 0;
+        };
+
+        Index *index;
+        int PADDING_1[32] = {};
+
+        int worker_count;
+        Schedule schedule;
+        long long min_chunk;
+
+        // The current loop, written by the caller before the start episode
+        long long loop_base = 0;
+        long long loop_size = 0;
+        std::function<void(long long, long long, int)> loop_body;
+        bool stopping = false;
+
+        std::vector<WorkerStats> stats;
+        FUNNEL_BARRIER::FunnelBarrier<Index, Wait> barrier; // workers + the caller
+        std::vector<std::thread> workers;
+
+        long long next_chunk(long long done) const
+        {
+            long long remaining = loop_size - done;
+            long long chunk = min_chunk;
+            if (schedule == GUIDED)
+                chunk = remaining / (GUIDED_FACTOR * worker_count);
+            else if (schedule == TRAPEZOID)
+            {
+                long long first = loop_size / (2 * worker_count);
+                chunk = first - (first - min_chunk) * done / loop_size;
+            }
+            return std::max(chunk, min_chunk);
+        }
+
+        void run_chunks(int worker_id)
+        {
+            WorkerStats &my_stats = stats[worker_id];
+            while (true)
+            {
+                long long done = index->load() - loop_base;
+                if (done >= loop_size)
+                    return;
+                long long chunk = next_chunk(done);
+                long long from = index->fetch_add(chunk, worker_id) - loop_base;
+                if (from >= loop_size)
+                    return;
+                long long to = std::min(from + chunk, loop_size);
+                loop_body(from, to, worker_id);
+                my_stats.chunk_count++;
+                my_stats.iteration_count += to - from;
+            }
+        }
+
+        void worker_loop(int worker_id)
+        {
+            while (true)
+            {
+                barrier.arrive_and_wait(worker_id);
+                if (stopping)
+                    return;
+                run_chunks(worker_id);
+                barrier.arrive_and_wait(worker_id);
+            }
+        }
+
+    public:
+        ChunkScheduler(int worker_count, Schedule schedule = GUIDED, long long min_chunk = 1)
+            : worker_count(worker_count), schedule(schedule), min_chunk(std::max(min_chunk, 1LL)), stats(worker_count), barrier(worker_count + 1)
+        {
+            index = new Index(worker_count);
+            for (int i = 0; i < worker_count; i++)
+                workers.push_back(std::thread(&ChunkScheduler::worker_loop, this, i));
+        }
+        ~ChunkScheduler()
+        {
+            stopping = true;
+            barrier.arrive_and_wait(worker_count);
+            for (auto &t : workers)
+                t.join();
+            delete index;
+        }
+
+        // body(from, to, worker_id) runs iterations [from, to) of [begin, end).
+        // Returns once every iteration is done; one loop at a time.
+        void parallel_for_chunks(long long begin, long long end, std::function<void(long long, long long, int)> body)
+        {
+            if (end <= begin)
+                return;
+            loop_base = index->load();
+            loop_size = end - begin;
+            loop_body = [&](long long from, long long to, int worker_id)
+            { body(begin + from, begin + to, worker_id); };
+            barrier.arrive_and_wait(worker_count);
+            barrier.arrive_and_wait(worker_count);
+        }
+
+        template <typename Body>
+        void parallel_for(long long begin, long long end, Body body)
+        {
+            parallel_for_chunks(begin, end, [&](long long from, long long to, int worker_id)
+                                {
+                for (long long i = from; i < to; i++)
+                    body(i); });
+        }
+
+        int size() const { return worker_count; }
+        long long chunk_count(int worker_id) const { return stats[worker_id].chunk_count; }
+        long long iteration_count(int worker_id) const { return stats[worker_id].iteration_count; }
+    };
+}
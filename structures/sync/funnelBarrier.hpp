@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "../counter/common.hpp"
+#include "./waitPolicy.hpp"
+
+// Reusable sense-reversing barrier whose arrivals go through a fetch_add
+// counter. The counter is never reset: arrival number i belongs to episode
+// i / participants, and the arrival that completes an episode flips the shared
+// sense. Everyone else waits for that flip on a line that stays in their cache
+// until it happens. Each thread's sense lives in its own padded slot.
+namespace FUNNEL_BARRIER
+{
+    template <typename Counter, typename Wait = WAIT_POLICY::SpinWait>
+    class FunnelBarrier
+    {
+    private:
+        struct alignas(64) LocalSense
+        {
+            bool sense = false;
+            int PADDING[15] = {};
+        };
+
+        Counter *arrivals;
+        long long participants;
+        std::vector<LocalSense> local_sense;
+        int PADDING_1[32] = {};
+        alignas(64) std::atomic<bool> sense = false;
+        int PADDING_2[32] = {};
+        Wait waiter;
+
+    public:
+        // thread_id in arrive_and_wait must be below participants
+        FunnelBarrier(int participants) : participants(participants), local_sense(participants)
+        {
+            arrivals = new Counter(participants);
+        }
+        ~FunnelBarrier() { delete arrivals; }
+
+        // Returns true to the one thread that completed the episode
+        bool arrive_and_wait(int thread_id)
+        {
+            bool my_sense = !local_sense[thread_id].sense;
+            local_sense[thread_id].sense = my_sense;
+            long long arrival = arrivals->fetch_add(1, thread_id);
+            if (arrival % participants == participants - 1)
+            {
+                sense.store(my_sense);
+                waiter.notify_all();
+                return true;
+            }
+            if (sense.load() != my_sense)
+                waiter.wait_until([&]()
+                                  { return sense.load() == my_sense; });
+            return false;
+        }
+
+        long long episodes() const
+        {
+            return arrivals->load() / participants;
+        }
+    };
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+
+#include "../counter/common.hpp"
+#include "./waitPolicy.hpp"
+
+// Ticket lock and phase-fair reader-writer lock whose ticket dispensers are
+// fetch_add counters, so a funnel (or HardwareCounter as the baseline) takes the
+// ticket FAA contention. Both are FIFO: tickets are handed out at the root in
+// one total order, and the funnels linearize every fetch_add at the root.
+//
+// The uncontended path does not go through the funnel: if the lock looks free,
+// one CAS on the dispenser's root takes the next ticket, as a TTAS lock would.
+// The funnel is only used once that CAS fails or the lock is held.
+namespace FUNNEL_LOCKS
+{
+    template <typename Index, typename Wait = WAIT_POLICY::SpinWait>
+    class TicketLock
+    {
+    private:
+        Index *dispenser;
+        int PADDING_1[32] = {};
+        alignas(64) std::atomic<long long> serving = 0;
+        int PADDING_2[32] = {};
+        Wait waiter;
+
+    public:
+        TicketLock(int thread_count)
+        {
+            dispenser = new Index(thread_count);
+        }
+        ~TicketLock() { delete dispenser; }
+
+        void lock(int thread_id)
+        {
+            long long ticket = serving.load();
+            long long expected = ticket;
+            if (dispenser->load() != ticket || !dispenser->compare_exchange(expected, ticket + 1))
+                ticket = dispenser->fetch_add(1, thread_id);
+            if (serving.load() != ticket)
+                waiter.wait_until([&]()
+                                  { return serving.load() == ticket; });
+        }
+
+        bool try_lock(int thread_id)
+        {
+            long long ticket = serving.load();
+            return dispenser->load() == ticket && dispenser->compare_exchange(ticket, ticket + 1);
+        }
+
+        void unlock(int thread_id)
+        {
+            serving.store(serving.load(std::memory_order_relaxed) + 1);
+            waiter.notify_all();
+        }
+    };
+
+    // PF-T from Brandenburg and Anderson. rin and rout count reader entries and
+    // exits in RINC units; the low bits of rin say whether a writer is present and
+    // which phase it is in. Readers wait for the phase to change, so readers and
+    // writers alternate. Writers only ever clear their own bits, which turns the
+    // original fetch_and into a CAS loop on rin's root.
+    template <typename Index, typename Wait = WAIT_POLICY::SpinWait>
+    class PhaseFairRWLock
+    {
+    private:
+        static const long long RINC = 0x100;
+        static const long long WBITS = 0x3;
+        static const long long PRES = 0x2;
+        static const long long PHID = 0x1;
+
+        Index *rin;
+        Index *rout;
+        Index *win;
+        int PADDING_1[32] = {};
+        alignas(64) std::atomic<long long> wout = 0;
+        long long writer_bits = 0; // written by the writer that holds the lock
+        int PADDING_2[32] = {};
+        Wait waiter;
+
+        static long long take_ticket(Index *dispenser, long long diff, long long expected, int thread_id)
+        {
+            long long seen = expected;
+            if (dispenser->load() == expected && dispenser->compare_exchange(seen, expected + diff))
+                return expected;
+            return dispenser->fetch_add(diff, thread_id);
+        }
+
+    public:
+        PhaseFairRWLock(int thread_count)
+        {
+            rin = new Index(thread_count);
+            rout = new Index(thread_count);
+            win = new Index(thread_count);
+        }
+        ~PhaseFairRWLock()
+        {
+            delete rin;
+            delete rout;
+            delete win;
+        }
+
+        void lock_shared(int thread_id)
+        {
+            long long seen = rin->load();
+            long long w;
+            if ((seen & WBITS) == 0 && rin->compare_exchange(seen, seen + RINC))
+                return;
+            w = rin->fetch_add(RINC, thread_id) & WBITS;
+            if (w != 0)
+                waiter.wait_until([&]()
+                                  { return (rin->load() & WBITS) != w; });
+        }
+
+        void unlock_shared(int thread_id)
+        {
+            take_ticket(rout, RINC, rout->load(), thread_id);
+            waiter.notify_all();
+        }
+
+        void lock(int thread_id)
+        {
+            long long ticket = take_ticket(win, 1, wout.load(), thread_id);
+            if (wout.load() != ticket)
+                waiter.wait_until([&]()
+                                  { return wout.load() == ticket; });
+
+            long long w = PRES | (ticket & PHID);
+            long long readers = rin->fetch_add(w, thread_id);
+            if (rout->load() != readers)
+                waiter.wait_until([&]()
+                                  { return rout->load() == readers; });
+            writer_bits = w;
+        }
+
+        void unlock(int thread_id)
+        {
+            long long seen = rin->load();
+            while (!rin->compare_exchange(seen, seen - writer_bits))
+                ;
+            wout.store(wout.load(std::memory_order_relaxed) + 1);
+            waiter.notify_all();
+        }
+    };
+}
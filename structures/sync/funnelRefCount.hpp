@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+
+#include "../counter/common.hpp"
+
+// Reference count split into two monotonic fetch_add counters, acquires and
+// releases, so each side can go through its own funnel and only ever needs
+// positive diffs. The count is acquires - releases.
+//
+// Zero detection: a release that brings releases to r then loads acquires and
+// reports zero iff it reads r. As long as the caller holds a reference while
+// acquiring another (the usual refcount rule), every acquire still in flight
+// belongs to a holder whose own reference is counted in acquires and not yet
+// in releases, so a non-final release always reads more than r. The final
+// release is the one with r equal to the total, and no acquire can follow it,
+// so exactly one release() returns true, however the two counters batch.
+namespace FUNNEL_REFCOUNT
+{
+    template <typename Counter>
+    class RefCount
+    {
+    private:
+        Counter *acquires;
+        Counter *releases;
+
+    public:
+        RefCount(long long initial, int thread_count)
+        {
+            acquires = new Counter(thread_count);
+            releases = new Counter(thread_count);
+            acquires->store(initial);
+        }
+        ~RefCount()
+        {
+            delete acquires;
+            delete releases;
+        }
+
+        void acquire(int thread_id)
+        {
+            acquires->fetch_add(1, thread_id);
+        }
+
+        // True to the one caller that dropped the last reference
+        bool release(int thread_id)
+        {
+            long long released = releases->fetch_add(1, thread_id) + 1;
+            return acquires->load() == released;
+        }
+
+        // Exact when nothing is in flight; releases is read first so it is
+        // never negative
+        long long count() const
+        {
+            long long released = releases->load();
+            return acquires->load() - released;
+        }
+    };
+}
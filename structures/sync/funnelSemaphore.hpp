@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "../counter/common.hpp"
+#include "./waitPolicy.hpp"
+
+// Counting semaphore and token bucket whose permit count is a fetch_add counter
+// that takes negative diffs, i.e. FullAggFunnelCounter (or HardwareCounter as
+// the baseline). Waiting goes through a policy from waitPolicy.hpp.
+namespace FUNNEL_SEMAPHORE
+{
+    template <typename Counter, typename Wait = WAIT_POLICY::SpinWait>
+    class FunnelSemaphore
+    {
+    private:
+        Counter *permits;
+        int PADDING_1[32] = {};
+        Wait waiter;
+
+    public:
+        FunnelSemaphore(long long initial, int thread_count)
+        {
+            permits = new Counter(initial, thread_count);
+        }
+        ~FunnelSemaphore() { delete permits; }
+
+        // One optimistic fetch_add(-k). If that overshot, the k permits go
+        // back, and since the overshoot may have made others fail too, waiters
+        // are notified as for a release.
+        bool try_acquire(long long k, int thread_id)
+        {
+            if (permits->fetch_add(-k, thread_id) >= k)
+                return true;
+            permits->fetch_add(k, thread_id);
+            waiter.notify_all();
+            return false;
+        }
+
+        void acquire(long long k, int thread_id)
+        {
+            while (!try_acquire(k, thread_id))
+                waiter.wait_until([&]()
+                                  { return permits->load() >= k; });
+        }
+
+        // Never lets the count go below 0, at the price of a CAS on the root
+        void acquire_bounded(long long k, int thread_id)
+        {
+            while (true)
+            {
+                long long available = permits->load();
+                if (available >= k)
+                {
+                    if (permits->compare_exchange(available, available - k))
+                        return;
+                }
+                else
+                    waiter.wait_until([&]()
+                                      { return permits->load() >= k; });
+            }
+        }
+
+        void release(long long k, int thread_id)
+        {
+            permits->fetch_add(k, thread_id);
+            waiter.notify_all();
+        }
+
+        // Can be negative for a moment while optimistic acquires overshoot
+        long long available() const
+        {
+            return permits->load();
+        }
+    };
+
+    // Token bucket holding up to capacity tokens, refilled at rate tokens per
+    // second. Refills are lazy: whoever finds that at least one token's worth of
+    // time passed moves last_refill forward with a CAS and adds the tokens, capped
+    // so the bucket stays under capacity. Only consumers change the count between
+    // the capping load and the add, so the cap can only be exceeded by tokens that
+    // failing consumers had taken for a moment and are about to put back.
+    template <typename Counter, typename Wait = WAIT_POLICY::SpinWait>
+    class TokenBucket
+    {
+    private:
+        Counter *tokens;
+        int PADDING_1[32] = {};
+        alignas(64) std::atomic<long long> last_refill_ns;
+        int PADDING_2[32] = {};
+
+        long long capacity;
+        double rate; // tokens per ns
+        std::chrono::steady_clock::time_point epoch;
+        Wait waiter;
+
+        long long now_ns() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        void refill(int thread_id)
+        {
+            long long last = last_refill_ns.load();
+            long long now = now_ns();
+            long long earned = (long long)((now - last) * rate);
+            if (earned <= 0)
+                return;
+            // Only credit the time the earned tokens account for
+            long long moved_to = last + (long long)(earned / rate);
+            if (!last_refill_ns.compare_exchange_strong(last, moved_to))
+                return; // someone else refilled
+            long long room = capacity - tokens->load();
+            if (room > 0)
+                tokens->fetch_add(std::min(earned, room), thread_id);
+        }
+
+    public:
+        TokenBucket(long long capacity, double tokens_per_second, int thread_count) : capacity(capacity), rate(tokens_per_second / 1e9)
+        {
+            epoch = std::chrono::steady_clock::now();
+            last_refill_ns.store(0);
+            tokens = new Counter(capacity, thread_count);
+        }
+        ~TokenBucket() { delete tokens; }
+
+        bool try_consume(long long k, int thread_id)
+        {
+            refill(thread_id);
+            if (tokens->fetch_add(-k, thread_id) >= k)
+                return true;
+            tokens->fetch_add(k, thread_id);
+            return false;
+        }
+
+        // Sleeps until k tokens should have accumulated; nothing notifies here
+        void consume(long long k, int thread_id)
+        {
+            while (!try_consume(k, thread_id))
+            {
+                long long missing = std::max(k - tokens->load(), 1LL);
+                waiter.sleep_until(std::chrono::steady_clock::now() + std::chrono::nanoseconds((long long)(missing / rate)));
+            }
+        }
+
+        long long available() const
+        {
+            return tokens->load();
+        }
+    };
+}
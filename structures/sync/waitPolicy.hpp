@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+
+// How the synchronization objects in this directory wait for a condition that
+// another thread makes true:
+//  - wait_until(ready):  return once ready() holds
+//  - notify_all():       called after a change that may make ready() hold
+//  - sleep_until(t):     wait for a point in time, when no one will notify
+//
+// notify_all must come after the change is visible through a seq_cst RMW or
+// store (every funnel root RMW is one), since ParkWait pairs that with its
+// seq_cst parked count to never miss a wakeup.
+namespace WAIT_POLICY
+{
+    // Busy-waits, like everything else in the repo
+    struct SpinWait
+    {
+        template <typename Ready>
+        void wait_until(Ready ready)
+        {
+            while (!ready())
+                ;
+        }
+
+        void notify_all() {}
+
+        void sleep_until(std::chrono::steady_clock::time_point t)
+        {
+            while (std::chrono::steady_clock::now() < t)
+                ;
+        }
+    };
+
+    // Spins for a while, then sleeps on a condition variable. Notifiers only
+    // take the mutex when someone is parked.
+    class ParkWait
+    {
+    private:
+        static const int SPIN_STEPS = 1024;
+
+        alignas(64) std::atomic<int> parked = 0;
+        std::mutex mtx;
+        std::condition_variable cv;
+
+    public:
+        template <typename Ready>
+        void wait_until(Ready ready)
+        {
+            for (int i = 0; i < SPIN_STEPS; i++)
+                if (ready())
+                    return;
+
+            std::unique_lock<std::mutex> lock(mtx);
+            parked.fetch_add(1);
+            while (!ready())
+                cv.wait(lock);
+            parked.fetch_sub(1);
+        }
+
+        void notify_all()
+        {
+            if (parked.load() == 0)
+                return;
+            std::lock_guard<std::mutex> lock(mtx);
+            cv.notify_all();
+        }
+
+        void sleep_until(std::chrono::steady_clock::time_point t)
+        {
+            std::this_thread::sleep_until(t);
+        }
+    };
+}
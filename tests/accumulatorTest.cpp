@@ -0,0 +1,97 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../structures/counter/accumulatorAggregatingFunnel.hpp"
+
+using namespace ACCUMULATOR_AGG_FUNNEL;
+
+// Every thread records the same value while a reader takes snapshots, so a
+// torn snapshot would break sum == count * value or min == max == value.
+template <typename T>
+void snapshot_test(int thread_count, int my_op_count, T value)
+{
+    std::cout << "Running snapshot test with " << thread_count << " threads" << std::endl;
+    auto *acc = new AccumulatorAggFunnel<T>(thread_count);
+    std::atomic<bool> done(false);
+
+    std::thread reader([&]()
+                       {
+        long long last_count = 0;
+        while (!done.load())
+        {
+            Stats<T> s = acc->load();
+            assert(s.count >= last_count);
+            assert(s.sum == value * s.count);
+            assert(s.count == 0 || (s.min == value && s.max == value));
+            last_count = s.count;
+        } });
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int i = 0; i < my_op_count; i++)
+                acc->record(value, id); }));
+    for (auto &t : threads)
+        t.join();
+    done.store(true);
+    reader.join();
+
+    Stats<T> s = acc->load();
+    assert(s.count == (long long)thread_count * my_op_count);
+    assert(s.sum == value * s.count);
+    std::cout << "Snapshots were consistent" << std::endl
+              << std::endl;
+    delete acc;
+}
+
+void aggregate_test(int thread_count, int my_op_count)
+{
+    std::cout << "Running aggregate test with " << thread_count << " threads" << std::endl;
+    auto *acc = new AccumulatorAggFunnel<long long>(thread_count);
+    std::vector<Stats<long long>> expected(thread_count);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            auto gen = std::mt19937(id);
+            for (int i = 0; i < my_op_count; i++)
+            {
+                long long value = (long long)(gen() % 2000000) - 1000000;
+                expected[id].add(value);
+                acc->record(value, id);
+            } }));
+    for (auto &t : threads)
+        t.join();
+
+    Stats<long long> all;
+    for (auto &e : expected)
+        all.merge(e);
+    Stats<long long> s = acc->load();
+    assert(s.count == all.count);
+    assert(s.sum == all.sum);
+    assert(s.min == all.min);
+    assert(s.max == all.max);
+    std::cout << "count=" << s.count << " sum=" << s.sum << " min=" << s.min << " max=" << s.max << std::endl
+              << std::endl;
+    delete acc;
+}
+
+int main(int argc, char const *argv[])
+{
+    for (int thread_count : {1, 4, 16, 64})
+    {
+        snapshot_test<long long>(thread_count, 400000 / thread_count, 7);
+        snapshot_test<double>(thread_count, 400000 / thread_count, 0.5);
+        aggregate_test(thread_count, 400000 / thread_count);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iomanip>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/configuredAggregatingFunnelCounter.hpp"
+#include "../structures/log/appendLog.hpp"
+
+using namespace APPEND_LOG;
+
+// Writers append records of random length tagged with (writer, sequence) and
+// filled with a byte pattern while one reader consumes. Small segments force
+// many rollovers and pad records. The reader must see every record once,
+// intact, and each writer's records in order.
+template <typename Log>
+void append_log_test(const char *name, int thread_count, long long segment_bytes, long long segment_count, int my_op_count)
+{
+    std::cout << name << ": " << thread_count << " writers, " << segment_count << " segments of " << segment_bytes << " bytes" << std::endl;
+    Log *log = new Log(segment_bytes, segment_count, thread_count);
+    long long max_payload = std::min(log->max_payload(), 200LL);
+    std::atomic<int> writers_done(0);
+
+    std::vector<long long> next_seq(thread_count, 0);
+    long long consumed = 0;
+    auto check = [&](const char *payload, long long bytes, long long offset)
+    {
+        long long header[2];
+        std::memcpy(header, payload, sizeof(header));
+        long long writer = header[0], seq = header[1];
+        assert(writer >= 0 && writer < thread_count);
+        assert(seq == next_seq[writer]);
+        next_seq[writer]++;
+        long long length = 16 + (writer * 31 + seq * 7) % (max_payload - 15);
+        assert(bytes == (length + 7) / 8 * 8);
+        for (long long i = 16; i < length; i++)
+            assert(payload[i] == (char)(writer + seq + i));
+        consumed++;
+    };
+    std::thread reader([&]()
+                       {
+        while (writers_done.load() != thread_count)
+            if (log->consume(check) == 0)
+                std::this_thread::yield();
+        log->consume(check); });
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::vector<char> record(max_payload);
+            long long last_offset = -1;
+            for (long long seq = 0; seq < my_op_count; seq++)
+            {
+                long long length = 16 + (id * 31 + seq * 7) % (max_payload - 15);
+                long long header[2] = {id, seq};
+                std::memcpy(record.data(), header, sizeof(header));
+                for (long long i = 16; i < length; i++)
+                    record[i] = (char)(id + seq + i);
+                long long offset = log->append(record.data(), length, id);
+                assert(offset > last_offset);
+                last_offset = offset;
+            }
+            writers_done.fetch_add(1); }));
+    for (auto &t : threads)
+        t.join();
+    reader.join();
+
+    assert(consumed == (long long)thread_count * my_op_count);
+    for (int id = 0; id < thread_count; id++)
+        assert(next_seq[id] == my_op_count);
+    assert(log->committed_prefix() == log->reserved());
+    std::cout << "Consumed " << consumed << " records through " << log->reserved() / segment_bytes << " segments" << std::endl
+              << std::endl;
+    delete log;
+}
+
+template <typename Index>
+void append_log_tests(const char *name)
+{
+    using Spin = WAIT_POLICY::SpinWait;
+    using Park = WAIT_POLICY::ParkWait;
+    append_log_test<AppendLog<Index, Park>>(name, 1, 256, 2, 20000);
+    append_log_test<AppendLog<Index, Spin>>(name, 2, 1 << 16, 4, 20000);
+    append_log_test<AppendLog<Index, Park>>(name, 4, 512, 4, 20000);
+    append_log_test<AppendLog<Index, Park>>(name, 16, 4096, 8, 5000);
+}
+
+int main(int argc, char const *argv[])
+{
+    append_log_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    append_log_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    return 0;
+}
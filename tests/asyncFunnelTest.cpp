@@ -0,0 +1,106 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include "../structures/async/simpleExecutor.hpp"
+#include "../structures/async/asyncFunnelCounter.hpp"
+
+using namespace ASYNC_EXECUTOR;
+using namespace ASYNC_FUNNEL;
+
+// task_count coroutines on worker_count executor threads each co_await
+// my_op_count increments of 1, yielding to the executor in between. Every
+// value 0 .. total - 1 must come back exactly once, and each task's values
+// must increase.
+Detached increment_task(SimpleExecutor &executor, AsyncFunnelCounter<long long> &counter, int id, int my_op_count,
+                        std::vector<std::atomic<int>> &seen, std::atomic<int> &done)
+{
+    co_await executor.schedule();
+    long long last = -1;
+    for (int i = 0; i < my_op_count; i++)
+    {
+        long long value = co_await counter.async_fetch_add(1, id, executor);
+        assert(value > last && value < (long long)seen.size());
+        last = value;
+        seen[value].fetch_add(1);
+        if (i % 3 == 0)
+            co_await executor.schedule();
+    }
+    done.fetch_add(1);
+}
+
+void async_test(int worker_count, int task_count, int fanout, int my_op_count)
+{
+    std::cout << worker_count << " workers, " << task_count << " tasks, fanout " << fanout << std::endl;
+    long long total = (long long)task_count * my_op_count;
+    AsyncFunnelCounter<long long> counter(0, task_count, fanout);
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> done(0);
+    {
+        SimpleExecutor executor(worker_count);
+        for (int id = 0; id < task_count; id++)
+            increment_task(executor, counter, id, my_op_count, seen, done);
+        while (done.load() != task_count)
+            std::this_thread::yield();
+    }
+    assert(counter.load() == total);
+    for (long long i = 0; i < total; i++)
+        assert(seen[i].load() == 1);
+    std::cout << "Handed out 0.." << total - 1 << " once each" << std::endl
+              << std::endl;
+}
+
+// Random diffs: the values a task gets back, paired with its diffs, must be
+// disjoint ranges that tile [0, sum)
+Detached range_task(SimpleExecutor &executor, AsyncFunnelCounter<long long> &counter, int id, int my_op_count,
+                    std::vector<std::atomic<int>> &covered, std::atomic<int> &done)
+{
+    co_await executor.schedule();
+    for (int i = 0; i < my_op_count; i++)
+    {
+        long long diff = (i * 13 + id * 7) % 9 + 1;
+        long long from = co_await counter.async_fetch_add(diff, id, executor);
+        for (long long v = from; v < from + diff; v++)
+            covered[v].fetch_add(1);
+    }
+    done.fetch_add(1);
+}
+
+void range_test(int worker_count, int task_count, int fanout, int my_op_count)
+{
+    std::cout << "Ranges: " << worker_count << " workers, " << task_count << " tasks, fanout " << fanout << std::endl;
+    long long total = 0;
+    for (int id = 0; id < task_count; id++)
+        for (int i = 0; i < my_op_count; i++)
+            total += (i * 13 + id * 7) % 9 + 1;
+    AsyncFunnelCounter<long long> counter(0, task_count, fanout);
+    std::vector<std::atomic<int>> covered(total);
+    std::atomic<int> done(0);
+    {
+        SimpleExecutor executor(worker_count);
+        for (int id = 0; id < task_count; id++)
+            range_task(executor, counter, id, my_op_count, covered, done);
+        while (done.load() != task_count)
+            std::this_thread::yield();
+    }
+    assert(counter.load() == total);
+    for (long long i = 0; i < total; i++)
+        assert(covered[i].load() == 1);
+    std::cout << "Ranges tile [0, " << total << ")" << std::endl
+              << std::endl;
+}
+
+int main(int argc, char const *argv[])
+{
+    async_test(1, 1, 1, 20000);
+    async_test(1, 64, 1, 1000);
+    async_test(2, 16, 2, 5000);
+    async_test(4, 256, 4, 200);
+    async_test(8, 100, 3, 500);
+    range_test(1, 32, 1, 1000);
+    range_test(4, 64, 2, 500);
+    return 0;
+}
@@ -0,0 +1,64 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <iomanip>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/configuredAggregatingFunnelCounter.hpp"
+#include "../structures/sync/funnelBarrier.hpp"
+
+using namespace FUNNEL_BARRIER;
+
+// Every thread marks each episode before arriving; after the barrier all marks
+// of that episode must be there, and exactly one arrival completes it
+template <typename Barrier>
+void barrier_test(const char *name, int thread_count, int episodes)
+{
+    std::cout << name << ": " << thread_count << " threads, " << episodes << " episodes" << std::endl;
+    Barrier *barrier = new Barrier(thread_count);
+    std::vector<std::atomic<int>> arrived(episodes);
+    std::vector<std::atomic<int>> completed(episodes);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int e = 0; e < episodes; e++)
+            {
+                arrived[e].fetch_add(1);
+                if (barrier->arrive_and_wait(id))
+                    completed[e].fetch_add(1);
+                assert(arrived[e].load() == thread_count);
+                if (e + 1 < episodes)
+                    assert(arrived[e + 1].load() < thread_count);
+            } }));
+    for (auto &t : threads)
+        t.join();
+    for (int e = 0; e < episodes; e++)
+        assert(completed[e].load() == 1);
+    assert(barrier->episodes() == episodes);
+    std::cout << "Every episode waited for everyone" << std::endl
+              << std::endl;
+    delete barrier;
+}
+
+template <typename Counter>
+void barrier_tests(const char *name)
+{
+    using Spin = WAIT_POLICY::SpinWait;
+    using Park = WAIT_POLICY::ParkWait;
+    barrier_test<FunnelBarrier<Counter, Spin>>(name, 1, 1000);
+    barrier_test<FunnelBarrier<Counter, Spin>>(name, 2, 1000);
+    barrier_test<FunnelBarrier<Counter, Park>>(name, 8, 5000);
+    barrier_test<FunnelBarrier<Counter, Park>>(name, 33, 1000);
+}
+
+int main(int argc, char const *argv[])
+{
+    barrier_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    barrier_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    return 0;
+}
@@ -0,0 +1,146 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/combinerAggregatingFunnel.hpp"
+
+using namespace COMBINERS;
+
+template <typename T, typename C, typename F>
+std::vector<std::vector<T>> run_threads(C *counter, int thread_count, int my_op_count, F operand)
+{
+    std::vector<std::vector<T>> results(thread_count, std::vector<T>(my_op_count));
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int i = 0; i < my_op_count; i++)
+                results[id][i] = counter->fetch_op(operand(id, i), id); }));
+    for (auto &t : threads)
+        t.join();
+    return results;
+}
+
+// Each result is the previous exchange's operand, so the results together with
+// the final value are a permutation of the start value and all operands.
+template <template <typename, typename> class C>
+void exchange_test(int thread_count, int my_op_count)
+{
+    auto *counter = new C<long long, ExchangeCombiner<long long>>(-1, thread_count);
+    auto results = run_threads<long long>(counter, thread_count, my_op_count, [&](int id, int i)
+                                          { return (long long)id * my_op_count + i; });
+
+    std::vector<long long> seen = {counter->load()};
+    for (auto &r : results)
+        seen.insert(seen.end(), r.begin(), r.end());
+    std::sort(seen.begin(), seen.end());
+    for (long long i = 0; i < (long long)seen.size(); i++)
+        assert(seen[i] == i - 1);
+    std::cout << "  exchange: ok" << std::endl;
+    delete counter;
+}
+
+// Integral doubles are exact, so the returned ranges must tile like fetch_add
+template <template <typename, typename> class C>
+void double_add_test(int thread_count, int my_op_count)
+{
+    auto *counter = new C<double, AddCombiner<double>>(0.0, thread_count);
+    auto results = run_threads<double>(counter, thread_count, my_op_count, [](int id, int i)
+                                          { return (double)(id % 3 + 1); });
+
+    std::vector<std::pair<double, double>> all;
+    for (int id = 0; id < thread_count; id++)
+        for (double r : results[id])
+            all.push_back({r, (double)(id % 3 + 1)});
+    std::sort(all.begin(), all.end());
+    double expected = 0;
+    for (auto &[res, diff] : all)
+    {
+        assert(res == expected);
+        expected += diff;
+    }
+    assert(counter->load() == expected);
+    std::cout << "  double add: ok" << std::endl;
+    delete counter;
+}
+
+template <template <typename, typename> class C>
+void max_test(int thread_count, int my_op_count)
+{
+    auto *counter = new C<long long, MaxCombiner<long long>>(0, thread_count);
+    std::vector<std::vector<long long>> operands(thread_count, std::vector<long long>(my_op_count));
+    std::mt19937 gen(thread_count);
+    for (auto &ops : operands)
+        for (auto &x : ops)
+            x = gen() % 1000000 + 1;
+    auto results = run_threads<long long>(counter, thread_count, my_op_count, [&](int id, int i)
+                                          { return operands[id][i]; });
+
+    long long mx = 0;
+    std::vector<long long> all = {0};
+    for (auto &ops : operands)
+    {
+        mx = std::max(mx, *std::max_element(ops.begin(), ops.end()));
+        all.insert(all.end(), ops.begin(), ops.end());
+    }
+    std::sort(all.begin(), all.end());
+    assert(counter->load() == mx);
+    for (int id = 0; id < thread_count; id++)
+        for (int i = 0; i < my_op_count; i++)
+        {
+            assert(std::binary_search(all.begin(), all.end(), results[id][i]));
+            // results seen by one thread never decrease
+            assert(i == 0 || results[id][i - 1] <= results[id][i]);
+        }
+    std::cout << "  max: ok" << std::endl;
+    delete counter;
+}
+
+// Thread id sets bit id, each thread sees its own earlier bits in later results
+template <template <typename, typename> class C>
+void or_test(int thread_count, int my_op_count)
+{
+    auto *counter = new C<long long, OrCombiner<long long>>(0, thread_count);
+    auto results = run_threads<long long>(counter, thread_count, my_op_count, [](int id, int i)
+                                          { return 1ll << id; });
+
+    long long all_bits = thread_count == 64 ? -1 : (1ll << thread_count) - 1;
+    assert(counter->load() == all_bits);
+    for (int id = 0; id < thread_count; id++)
+        for (int i = 1; i < my_op_count; i++)
+        {
+            assert((results[id][i] & ~all_bits) == 0);
+            assert(results[id][i] & (1ll << id));
+            assert((results[id][i - 1] & results[id][i]) == results[id][i - 1]);
+        }
+    std::cout << "  or: ok" << std::endl;
+    delete counter;
+}
+
+template <template <typename, typename> class C>
+void combiner_tests(const char *name)
+{
+    for (int thread_count : {1, 4, 16, 64})
+    {
+        std::cout << name << " with " << thread_count << " threads" << std::endl;
+        int my_op_count = 400000 / thread_count;
+        exchange_test<C>(thread_count, my_op_count);
+        double_add_test<C>(thread_count, my_op_count);
+        max_test<C>(thread_count, my_op_count);
+        or_test<C>(thread_count, my_op_count);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    combiner_tests<HARDWARE_ATOMIC::HardwareRMW>("HardwareRMW");
+    combiner_tests<COMBINER_AGG_FUNNEL::CombinerAggFunnel>("CombinerAggFunnel");
+    return 0;
+}
@@ -184,6 +184,120 @@ int multi_test(int thread_count, int ops_count = 100000, bool print = true)
     return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 }
 
+// Every thread runs fetch_add back to back and keeps every result. The returned
+// ranges [res, res + diff) must tile [0, total) exactly, and each thread must
+// see its own results increase.
+void stress_test(int thread_count, int ops_count = 1000000)
+{
+    TargetCounter *counter = get_target_counter(thread_count);
+
+    std::cout << "Running stress test with " << thread_count << " threads, " << ops_count << " operations" << std::endl;
+
+    int time_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cout << "Seed: " << time_seed << std::endl;
+
+    int my_op_count = ops_count / thread_count;
+    std::vector<std::vector<std::pair<long long, long long>>> ranges(thread_count);
+    for (auto &r : ranges)
+        r.resize(my_op_count);
+
+    auto thread_func = [&](int id)
+    {
+        auto gen = get_mt_generator(time_seed * 1000 + id);
+        auto &mine = ranges[id];
+        for (int i = 0; i < my_op_count; i++)
+        {
+            long long diff = gen() % 8 + 1;
+            mine[i] = std::make_pair(counter->fetch_add(diff, id), diff);
+        }
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++)
+        threads.push_back(std::thread(thread_func, i));
+    for (auto &t : threads)
+        t.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Elapsed time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+
+    std::vector<std::pair<long long, long long>> all;
+    for (auto &r : ranges)
+    {
+        for (int i = 1; i < my_op_count; i++)
+            assert(r[i - 1].first < r[i].first);
+        all.insert(all.end(), r.begin(), r.end());
+    }
+    std::sort(all.begin(), all.end());
+    long long expected = 0;
+    for (auto &[res, diff] : all)
+    {
+        assert(res == expected);
+        expected += diff;
+    }
+    assert(counter->load() == expected);
+    std::cout << "Returned ranges tile [0, " << expected << ")" << std::endl
+              << std::endl;
+
+    delete counter;
+}
+
+void deadline_test(int thread_count, int ops_count = 100000)
+{
+    TargetCounter *counter = get_target_counter(thread_count);
+
+    std::cout << "Running deadline test with " << thread_count << " threads, " << ops_count << " operations" << std::endl;
+
+    int time_seed = std::chrono::system_clock::now().time_since_epoch().count() % 1000000;
+    std::cout << "Seed: " << time_seed << std::endl;
+
+    std::atomic<long long> timeouts(0);
+    std::vector<long long> answered;
+    std::mutex mtx;
+
+    auto thread_func = [&](int id)
+    {
+        auto gen = get_mt_generator(time_seed * 1000 + id);
+        int my_op_count = ops_count / thread_count;
+        std::vector<long long> local;
+        long long local_timeouts = 0;
+        for (int i = 0; i < my_op_count; i++)
+        {
+            // deadlines from already expired up to a few microseconds
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(gen() % 4000);
+            long long res;
+            if (counter->try_fetch_add(1, id, deadline, res))
+                local.push_back(res);
+            else
+                local_timeouts++;
+        }
+        mtx.lock();
+        answered.insert(answered.end(), local.begin(), local.end());
+        timeouts += local_timeouts;
+        mtx.unlock();
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++)
+        threads.push_back(std::thread(thread_func, i));
+    for (auto &t : threads)
+        t.join();
+
+    // timed out increments are still applied exactly once
+    long long total = (long long)(ops_count / thread_count) * thread_count;
+    std::cout << "Answered: " << answered.size() << ", timed out: " << timeouts.load() << std::endl;
+    assert((long long)answered.size() + timeouts.load() == total);
+    assert(counter->load() == total);
+
+    std::sort(answered.begin(), answered.end());
+    assert(std::unique(answered.begin(), answered.end()) == answered.end());
+    assert(answered.empty() || (answered.front() >= 0 && answered.back() < total));
+    std::cout << "Answered results are unique" << std::endl
+              << std::endl;
+
+    delete counter;
+}
+
 int main(int argc, char const *argv[])
 {
     simple_test();
@@ -197,5 +311,13 @@ int main(int argc, char const *argv[])
     multi_test(48, 1600000);
     multi_test(64, 6400000);
 
+    stress_test(4, 400000);
+    stress_test(16, 1600000);
+    stress_test(64, 1600000);
+
+    deadline_test(4, 100000);
+    deadline_test(16, 400000);
+    deadline_test(64, 1600000);
+
     return 0;
 }
@@ -0,0 +1,153 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <csignal>
+#include <iomanip>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/configuredAggregatingFunnelCounter.hpp"
+#include "../structures/durable/durableCounter.hpp"
+
+using namespace DURABLE_COUNTER;
+
+// A child process hands out values with random diffs and gets killed without
+// any cleanup. Each run after it must start above every value it returned, and
+// skip less than a chunk. Runs restart on the same file several times.
+template <typename Index>
+void recovery_test(const char *name, int thread_count, long long chunk, int my_op_count, int restarts)
+{
+    std::cout << name << ": " << thread_count << " threads, chunk " << chunk << ", " << restarts << " restarts" << std::endl;
+    std::string path = "/tmp/durable_test_" + std::to_string(getpid());
+    std::remove(path.c_str());
+
+    // Highest end (value + diff) each thread saw returned, shared with the child
+    std::atomic<long long> *ends = (std::atomic<long long> *)mmap(nullptr, thread_count * 64 * sizeof(long long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    long long start = 0;
+    for (int run = 0; run < restarts; run++)
+    {
+        for (int id = 0; id < thread_count; id++)
+            ends[id * 64].store(start);
+        std::cout.flush();
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0)
+        {
+            DurableCounter<Index> counter(path, chunk, thread_count);
+            assert(counter.recovered_from() == start);
+            std::vector<std::thread> threads;
+            for (int id = 0; id < thread_count; id++)
+                threads.push_back(std::thread([&, id]()
+                                              {
+                    long long last = -1;
+                    for (int i = 0; i < my_op_count; i++)
+                    {
+                        long long diff = (i * 7 + id) % 5 + 1;
+                        long long from = counter.fetch_add(diff, id);
+                        assert(from >= start && from > last);
+                        last = from;
+                        ends[id * 64].store(from + diff);
+                    } }));
+            for (auto &t : threads)
+                t.join();
+            raise(SIGKILL);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+
+        long long handed_out = start;
+        for (int id = 0; id < thread_count; id++)
+            handed_out = std::max(handed_out, ends[id * 64].load());
+        DurableCounter<Index> reopened(path, chunk, thread_count);
+        assert(reopened.recovered_from() >= handed_out);
+        assert(reopened.recovered_from() - handed_out < chunk);
+        assert(reopened.load() == reopened.recovered_from());
+        start = reopened.recovered_from();
+    }
+    std::cout << "Resumed above every returned value, now at " << start << std::endl
+              << std::endl;
+    munmap(ends, thread_count * 64 * sizeof(long long));
+    std::remove(path.c_str());
+}
+
+// One thread, no restarts: values are consecutive and the number of msyncs is
+// the number of chunks crossed
+template <typename Index>
+void chunk_test(const char *name, long long chunk, int op_count)
+{
+    std::cout << name << ": msyncs with chunk " << chunk << std::endl;
+    std::string path = "/tmp/durable_test_" + std::to_string(getpid());
+    std::remove(path.c_str());
+    {
+        DurableCounter<Index> counter(path, chunk, 1);
+        for (int i = 0; i < op_count; i++)
+            assert(counter.fetch_add(1, 0) == i);
+        assert(counter.msyncs() == (op_count + chunk - 1) / chunk);
+        assert(counter.persisted_mark() == (op_count + chunk - 1) / chunk * chunk);
+    }
+    std::cout << "One msync per chunk" << std::endl
+              << std::endl;
+    std::remove(path.c_str());
+}
+
+// A file that is not ours is refused, and the refusal leaks no descriptor
+template <typename Index>
+void foreign_file_test(const char *name)
+{
+    std::cout << name << ": foreign file" << std::endl;
+    std::string path = "/tmp/durable_test_" + std::to_string(getpid());
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    assert(write(fd, "not a counter", 13) == 13);
+    close(fd);
+
+    int lowest_free = dup(0);
+    close(lowest_free);
+    for (int i = 0; i < 3; i++)
+    {
+        bool refused = false;
+        try
+        {
+            DurableCounter<Index> counter(path, 16, 1);
+        }
+        catch (const std::runtime_error &)
+        {
+            refused = true;
+        }
+        assert(refused);
+    }
+    fd = dup(0);
+    assert(fd == lowest_free);
+    close(fd);
+    std::cout << "Refused without leaking" << std::endl
+              << std::endl;
+    std::remove(path.c_str());
+}
+
+template <typename Index>
+void durable_tests(const char *name)
+{
+    foreign_file_test<Index>(name);
+    chunk_test<Index>(name, 1, 100);
+    chunk_test<Index>(name, 64, 10000);
+    recovery_test<Index>(name, 1, 16, 2000, 3);
+    recovery_test<Index>(name, 4, 256, 5000, 3);
+    recovery_test<Index>(name, 8, 1024, 5000, 2);
+}
+
+int main(int argc, char const *argv[])
+{
+    durable_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    durable_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    return 0;
+}
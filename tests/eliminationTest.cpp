@@ -0,0 +1,95 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <map>
+#include <iomanip>
+
+#include "../structures/counter/fullAggregatingFunnelCounter.hpp"
+
+using namespace FULL_AGG_FUNNEL;
+
+// Threads add +1 or -1 at random. Every fetch_add(+1) returning v crosses the
+// edge (v, v + 1) upwards and every fetch_add(-1) returning v crosses (v - 1, v)
+// downwards, so for the returned values to come from one sequential history
+// from 0 to the final value F, each edge must be crossed upwards exactly once
+// more than downwards if it lies between 0 and F, and equally often otherwise.
+// Values handed out by eliminated batches have to satisfy this like any other.
+void unit_test(int thread_count, int my_op_count)
+{
+    std::cout << "+-1 test: " << thread_count << " threads" << std::endl;
+    FullAggFunnelCounter<long long> *counter = new FullAggFunnelCounter<long long>(thread_count);
+    std::vector<std::map<long long, long long>> crossings(thread_count);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::mt19937 gen(id);
+            for (int i = 0; i < my_op_count; i++)
+            {
+                if (gen() % 2)
+                    crossings[id][counter->fetch_add(1, id)]++;
+                else
+                    crossings[id][counter->fetch_add(-1, id) - 1]--;
+            } }));
+    for (auto &t : threads)
+        t.join();
+
+    std::map<long long, long long> net;
+    for (auto &local : crossings)
+        for (auto [edge, count] : local)
+            net[edge] += count;
+    long long final_value = counter->load();
+    for (auto [edge, count] : net)
+    {
+        long long expected = 0;
+        if (0 <= edge && edge < final_value)
+            expected = 1;
+        else if (final_value <= edge && edge < 0)
+            expected = -1;
+        assert(count == expected);
+    }
+    std::cout << "Returned values fit one history ending at " << final_value << std::endl
+              << std::endl;
+    delete counter;
+}
+
+// Balanced +x / -x pairs of random size: each thread's sum, and so the
+// counter, ends at 0
+void balanced_test(int thread_count, int my_op_count)
+{
+    std::cout << "Balanced test: " << thread_count << " threads" << std::endl;
+    FullAggFunnelCounter<long long> *counter = new FullAggFunnelCounter<long long>(thread_count);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::mt19937 gen(id);
+            for (int i = 0; i < my_op_count; i++)
+            {
+                long long x = gen() % 100 + 1;
+                counter->fetch_add(x, id);
+                counter->fetch_add(-x, id);
+            } }));
+    for (auto &t : threads)
+        t.join();
+    assert(counter->load() == 0);
+    std::cout << "Counter is back at 0" << std::endl
+              << std::endl;
+    delete counter;
+}
+
+int main(int argc, char const *argv[])
+{
+    for (int thread_count : {1, 2, 6, 12, 24})
+    {
+        unit_test(thread_count, 20000);
+        balanced_test(thread_count, 20000);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include "../structures/counter/funnelRef.hpp"
+
+using namespace FUNNEL_REF;
+
+// A word inside a struct that predates the funnel
+struct LegacyStats
+{
+    long long requests = 0;
+    std::atomic<long long> bytes;
+    long long errors = 0;
+};
+
+// direct_count threads do fetch_add on the word itself, the rest go through a
+// FunnelRef on it, with diffs that vary per operation. Every returned range,
+// direct or not, must tile [start, start + sum) without overlaps.
+void mixed_test(int direct_count, int funnel_count, int fanout, int my_op_count)
+{
+    std::cout << direct_count << " direct + " << funnel_count << " funnel writers, fanout " << fanout << std::endl;
+    const long long start = 1000;
+    LegacyStats stats;
+    stats.bytes.store(start);
+    FunnelRef<long long> *funnel = new FunnelRef<long long>(stats.bytes, funnel_count, fanout);
+
+    int thread_count = direct_count + funnel_count;
+    long long total = 0;
+    for (int id = 0; id < thread_count; id++)
+        for (int i = 0; i < my_op_count; i++)
+            total += (i * 5 + id * 3) % 7 + 1;
+    std::vector<std::atomic<int>> covered(total);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int i = 0; i < my_op_count; i++)
+            {
+                long long diff = (i * 5 + id * 3) % 7 + 1;
+                long long from = id < direct_count ? stats.bytes.fetch_add(diff) : funnel->fetch_add(diff, id - direct_count);
+                assert(from >= start && from + diff <= start + total);
+                for (long long v = from; v < from + diff; v++)
+                    covered[v - start].fetch_add(1);
+                assert(stats.bytes.load() >= from + diff);
+            } }));
+    for (auto &t : threads)
+        t.join();
+
+    assert(stats.bytes.load() == start + total);
+    assert(funnel->load() == start + total);
+    for (long long i = 0; i < total; i++)
+        assert(covered[i].load() == 1);
+    std::cout << "Ranges tile [" << start << ", " << start + total << ")" << std::endl
+              << std::endl;
+    delete funnel;
+}
+
+// Two FunnelRefs on one word, plus a thread that resets it with stores
+// between phases
+void two_fronts_test(int my_op_count)
+{
+    std::cout << "Two FunnelRefs on one word" << std::endl;
+    std::atomic<long long> word(0);
+    FunnelRef<long long> first(word, 2, 1), second(word, 2, 2);
+    for (int phase = 0; phase < 3; phase++)
+    {
+        word.store(phase * 1000000);
+        std::vector<std::thread> threads;
+        for (int id = 0; id < 4; id++)
+            threads.push_back(std::thread([&, id]()
+                                          {
+                for (int i = 0; i < my_op_count; i++)
+                    (id < 2 ? first : second).fetch_add(1, id % 2); }));
+        for (auto &t : threads)
+            t.join();
+        assert(word.load() == phase * 1000000 + 4LL * my_op_count);
+    }
+    std::cout << "Both fronts landed on the word" << std::endl
+              << std::endl;
+}
+
+int main(int argc, char const *argv[])
+{
+    mixed_test(0, 1, 1, 20000);
+    mixed_test(1, 1, 1, 20000);
+    mixed_test(2, 6, 2, 10000);
+    mixed_test(4, 12, 3, 5000);
+    mixed_test(8, 8, 8, 5000);
+    two_fronts_test(20000);
+    return 0;
+}
@@ -0,0 +1,73 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+
+#include "../structures/counter/recursiveAggregatingFunnelCounter.hpp"
+#include "../structures/allocator/rangeIdAllocator.hpp"
+
+using namespace RANGE_ID_ALLOCATOR;
+
+// Several waves of threads allocate IDs and leave, some after a few IDs and
+// some after many. All IDs must be unique, increase per thread, and together
+// with the unused leases account for everything below the high-water mark.
+template <typename Index>
+void allocator_test(const char *name, int thread_count, int wave_count, long long max_lease)
+{
+    std::cout << name << ": " << thread_count << " threads, " << wave_count << " waves, max lease " << max_lease << std::endl;
+    auto *allocator = new RangeIdAllocator<Index>(thread_count, max_lease);
+    std::vector<long long> all;
+
+    for (int wave = 0; wave < wave_count; wave++)
+    {
+        std::vector<std::vector<long long>> ids(thread_count);
+        std::vector<std::thread> threads;
+        for (int id = 0; id < thread_count; id++)
+            threads.push_back(std::thread([&, id]()
+                                          {
+                ThreadLease<RangeIdAllocator<Index>> lease(allocator, id);
+                std::mt19937 gen(wave * 1000 + id);
+                int my_count = gen() % 2 == 0 ? gen() % 100 : 20000 + gen() % 1000;
+                for (int i = 0; i < my_count; i++)
+                {
+                    long long x = lease.next_id();
+                    assert(ids[id].empty() || ids[id].back() < x);
+                    ids[id].push_back(x);
+                } }));
+        for (auto &t : threads)
+            t.join();
+        for (auto &v : ids)
+            all.insert(all.end(), v.begin(), v.end());
+    }
+
+    std::sort(all.begin(), all.end());
+    assert(std::unique(all.begin(), all.end()) == all.end());
+    assert(all.empty() || (all.front() >= 0 && all.back() < allocator->high_water()));
+    assert((long long)all.size() + allocator->unused() == allocator->high_water());
+    std::cout << all.size() << " unique IDs, " << allocator->unused() << " returned unused, high water " << allocator->high_water() << std::endl
+              << std::endl;
+    delete allocator;
+}
+
+template <typename Index>
+void allocator_tests(const char *name)
+{
+    allocator_test<Index>(name, 1, 3, 4096);
+    allocator_test<Index>(name, 4, 4, 1);
+    allocator_test<Index>(name, 8, 4, 64);
+    allocator_test<Index>(name, 32, 3, 4096);
+}
+
+int main(int argc, char const *argv[])
+{
+    allocator_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    allocator_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    allocator_tests<RECURSIVE_AGG_FUNNEL::RecursiveAggFunnelCounter<long long>>("RecursiveAggFunnelCounter");
+    return 0;
+}
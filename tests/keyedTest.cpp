@@ -0,0 +1,75 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <tuple>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/keyedAggregatingFunnel.hpp"
+
+// Threads add to random keys, a quarter of the adds going to key 0. For each key
+// the returned ranges [res, res + diff) must tile [0, load(key)).
+template <typename C>
+void keyed_test(const char *name, int thread_count, int key_count, int my_op_count)
+{
+    std::cout << name << ": " << thread_count << " threads, " << key_count << " keys" << std::endl;
+    C *counter = new C(key_count, thread_count);
+
+    std::vector<std::vector<std::tuple<int, long long, long long>>> ops(thread_count);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::mt19937 gen(id);
+            std::vector<long long> last(key_count, -1);
+            for (int i = 0; i < my_op_count; i++)
+            {
+                int key = gen() % 4 == 0 ? 0 : gen() % key_count;
+                long long diff = gen() % 8 + 1;
+                long long res = counter->fetch_add(key, diff, id);
+                // a thread's results on one key increase
+                assert(last[key] < res);
+                last[key] = res;
+                ops[id].emplace_back(key, res, diff);
+            } }));
+    for (auto &t : threads)
+        t.join();
+
+    std::vector<std::tuple<int, long long, long long>> all;
+    for (auto &o : ops)
+        all.insert(all.end(), o.begin(), o.end());
+    std::sort(all.begin(), all.end());
+    std::vector<long long> expected(key_count, 0);
+    for (auto &[key, res, diff] : all)
+    {
+        assert(res == expected[key]);
+        expected[key] += diff;
+    }
+    for (int key = 0; key < key_count; key++)
+        assert(counter->load(key) == expected[key]);
+    std::cout << "Returned ranges tile every key" << std::endl
+              << std::endl;
+    delete counter;
+}
+
+template <typename C>
+void keyed_tests(const char *name)
+{
+    keyed_test<C>(name, 1, 16, 20000);
+    keyed_test<C>(name, 4, 1, 20000);
+    keyed_test<C>(name, 8, 16, 20000);
+    keyed_test<C>(name, 16, 1000, 10000);
+    keyed_test<C>(name, 64, 64, 500); // oversubscribed on most machines
+}
+
+int main(int argc, char const *argv[])
+{
+    keyed_tests<HARDWARE_ATOMIC::KeyedHardwareCounter<long long>>("KeyedHardwareCounter");
+    keyed_tests<KEYED_AGG_FUNNEL::KeyedAggFunnel<long long>>("KeyedAggFunnel");
+    return 0;
+}
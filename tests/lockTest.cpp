@@ -0,0 +1,152 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <iomanip>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/configuredAggregatingFunnelCounter.hpp"
+#include "../structures/sync/funnelLocks.hpp"
+
+using namespace FUNNEL_LOCKS;
+
+// Plain increments under the lock must not be lost, and no two threads may be
+// inside at once
+template <typename Lock>
+void ticket_lock_test(const char *name, int thread_count, int my_op_count)
+{
+    std::cout << name << ": " << thread_count << " threads" << std::endl;
+    Lock *lock = new Lock(thread_count);
+    long long value = 0;
+    std::atomic<int> inside(0);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int i = 0; i < my_op_count; i++)
+            {
+                lock->lock(id);
+                assert(inside.fetch_add(1) == 0);
+                value++;
+                inside.fetch_sub(1);
+                lock->unlock(id);
+            } }));
+    for (auto &t : threads)
+        t.join();
+    assert(value == (long long)thread_count * my_op_count);
+    assert(lock->try_lock(0));
+    assert(!lock->try_lock(1));
+    lock->unlock(0);
+    std::cout << "Counted " << value << " under the lock" << std::endl
+              << std::endl;
+    delete lock;
+}
+
+// Threads that queue up in order get the lock in that order: each thread takes
+// its ticket only after the previous one is known to be waiting
+template <typename Lock>
+void fifo_test(const char *name, int thread_count)
+{
+    std::cout << name << " FIFO: " << thread_count << " threads" << std::endl;
+    Lock *lock = new Lock(thread_count + 1);
+    std::vector<int> order;
+    std::atomic<int> queued(0);
+
+    lock->lock(thread_count);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+    {
+        threads.push_back(std::thread([&, id]()
+                                      {
+            queued.store(id + 1);
+            lock->lock(id);
+            order.push_back(id);
+            lock->unlock(id); }));
+        while (queued.load() != id + 1)
+            ;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5)); // let it take its ticket
+    }
+    lock->unlock(thread_count);
+    for (auto &t : threads)
+        t.join();
+    for (int id = 0; id < thread_count; id++)
+        assert(order[id] == id);
+    std::cout << "Served in arrival order" << std::endl
+              << std::endl;
+    delete lock;
+}
+
+// Writers keep two values equal, readers must never see them differ, and no
+// reader may be inside together with a writer
+template <typename Lock>
+void rw_lock_test(const char *name, int thread_count, int my_op_count, int read_percent)
+{
+    std::cout << name << " RW: " << thread_count << " threads, " << read_percent << "% reads" << std::endl;
+    Lock *lock = new Lock(thread_count);
+    volatile long long a = 0, b = 0;
+    std::atomic<int> readers(0), writers(0);
+    std::atomic<long long> write_count(0);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::mt19937 gen(id);
+            for (int i = 0; i < my_op_count; i++)
+            {
+                if ((int)(gen() % 100) < read_percent)
+                {
+                    lock->lock_shared(id);
+                    readers.fetch_add(1);
+                    assert(writers.load() == 0);
+                    assert(a == b);
+                    readers.fetch_sub(1);
+                    lock->unlock_shared(id);
+                }
+                else
+                {
+                    lock->lock(id);
+                    assert(writers.fetch_add(1) == 0);
+                    assert(readers.load() == 0);
+                    a = a + 1;
+                    b = b + 1;
+                    writers.fetch_sub(1);
+                    lock->unlock(id);
+                    write_count.fetch_add(1);
+                }
+            } }));
+    for (auto &t : threads)
+        t.join();
+    assert(a == write_count.load() && b == write_count.load());
+    std::cout << write_count.load() << " writes, readers never overlapped them" << std::endl
+              << std::endl;
+    delete lock;
+}
+
+template <typename Index>
+void lock_tests(const char *name)
+{
+    using Spin = WAIT_POLICY::SpinWait;
+    using Park = WAIT_POLICY::ParkWait;
+    ticket_lock_test<TicketLock<Index, Spin>>(name, 2, 2000);
+    ticket_lock_test<TicketLock<Index, Park>>(name, 8, 20000);
+    ticket_lock_test<TicketLock<Index, Park>>(name, 32, 2000);
+    fifo_test<TicketLock<Index, Park>>(name, 8);
+    for (int read_percent : {0, 50, 95})
+    {
+        rw_lock_test<PhaseFairRWLock<Index, Spin>>(name, 2, 2000, read_percent);
+        rw_lock_test<PhaseFairRWLock<Index, Park>>(name, 8, 20000, read_percent);
+        rw_lock_test<PhaseFairRWLock<Index, Park>>(name, 32, 2000, read_percent);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    lock_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    lock_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    return 0;
+}
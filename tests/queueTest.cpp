@@ -0,0 +1,118 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+
+#include "../structures/counter/recursiveAggregatingFunnelCounter.hpp"
+#include "../structures/queue/funnelRingQueue.hpp"
+
+// Producers enqueue (producer, seq) pairs and consumers dequeue them. Every value
+// must come out exactly once, and one consumer must see each producer's values in
+// increasing order. With use_try the consumers poll try_dequeue, so tickets of
+// dequeues that find the queue empty race with the enqueues that get them.
+template <typename Index>
+void producer_consumer_test(const char *name, int producer_count, int consumer_count, int my_op_count, long long capacity, bool use_try = false)
+{
+    std::cout << name << ": " << producer_count << " producers, " << consumer_count << " consumers, capacity " << capacity << (use_try ? ", try_dequeue" : "") << std::endl;
+    int thread_count = producer_count + consumer_count;
+    auto *queue = new FUNNEL_RING_QUEUE::RingQueue<long long, Index>(capacity, thread_count);
+    long long total = (long long)producer_count * my_op_count;
+    std::vector<std::vector<long long>> seen(consumer_count);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producer_count; p++)
+        threads.push_back(std::thread([&, p]()
+                                      {
+            for (long long i = 0; i < my_op_count; i++)
+                queue->enqueue(((long long)p << 32) | i, p); }));
+    for (int c = 0; c < consumer_count; c++)
+        threads.push_back(std::thread([&, c]()
+                                      {
+            // consumers split the total, the first one takes the remainder
+            long long mine = total / consumer_count + (c == 0 ? total % consumer_count : 0);
+            for (long long i = 0; i < mine; i++)
+            {
+                long long value;
+                if (!use_try)
+                    value = queue->dequeue(producer_count + c);
+                else
+                    while (!queue->try_dequeue(value, producer_count + c))
+                        ;
+                seen[c].push_back(value);
+            } }));
+    for (auto &t : threads)
+        t.join();
+    assert(queue->size() == 0);
+
+    std::vector<long long> all;
+    for (auto &s : seen)
+    {
+        std::vector<long long> last(producer_count, -1);
+        for (long long v : s)
+        {
+            int p = v >> 32;
+            assert(p >= 0 && p < producer_count);
+            assert(last[p] < (v & 0xffffffffLL));
+            last[p] = v & 0xffffffffLL;
+        }
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    std::sort(all.begin(), all.end());
+    assert((long long)all.size() == total);
+    for (int p = 0; p < producer_count; p++)
+        for (long long i = 0; i < my_op_count; i++)
+            assert(all[(long long)p * my_op_count + i] == (((long long)p << 32) | i));
+    std::cout << "Every value was dequeued once, in per-producer order" << std::endl
+              << std::endl;
+    delete queue;
+}
+
+// try_dequeue returns false on an empty queue without taking a ticket, so
+// values enqueued afterwards still come out in order
+template <typename Index>
+void try_dequeue_test(const char *name, long long capacity)
+{
+    std::cout << name << ": try_dequeue, capacity " << capacity << std::endl;
+    auto *queue = new FUNNEL_RING_QUEUE::RingQueue<long long, Index>(capacity, 1);
+    long long value = -1;
+    for (int round = 0; round < 3; round++)
+    {
+        assert(!queue->try_dequeue(value, 0));
+        assert(!queue->try_dequeue(value, 0));
+        for (long long i = 0; i < capacity; i++)
+            queue->enqueue(round * capacity + i, 0);
+        for (long long i = 0; i < capacity; i++)
+        {
+            assert(queue->try_dequeue(value, 0));
+            assert(value == round * capacity + i);
+        }
+        assert(queue->size() == 0);
+    }
+    std::cout << "Empty tries returned false and left no gap" << std::endl
+              << std::endl;
+    delete queue;
+}
+
+template <typename Index>
+void queue_tests(const char *name)
+{
+    try_dequeue_test<Index>(name, 8);
+    producer_consumer_test<Index>(name, 1, 1, 100000, 16);
+    producer_consumer_test<Index>(name, 4, 4, 50000, 64);
+    producer_consumer_test<Index>(name, 8, 2, 20000, 1024);
+    producer_consumer_test<Index>(name, 2, 30, 80000, 8);
+    producer_consumer_test<Index>(name, 4, 4, 50000, 64, true);
+}
+
+int main(int argc, char const *argv[])
+{
+    queue_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    queue_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    queue_tests<RECURSIVE_AGG_FUNNEL::RecursiveAggFunnelCounter<long long>>("RecursiveAggFunnelCounter");
+    return 0;
+}
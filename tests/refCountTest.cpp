@@ -0,0 +1,100 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <iomanip>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/configuredAggregatingFunnelCounter.hpp"
+#include "../structures/sync/funnelRefCount.hpp"
+
+using namespace FUNNEL_REFCOUNT;
+
+// Each round the owner hands a reference to every thread. Threads pass extra
+// references around (acquired while holding one) and drop them in random
+// order, racing with the owner's own release. Exactly one release per round
+// may see zero, and only after every other release.
+template <typename RefCountType>
+void refcount_test(const char *name, int thread_count, int rounds, int my_op_count)
+{
+    std::cout << name << ": " << thread_count << " threads, " << rounds << " rounds" << std::endl;
+    std::atomic<int> round(0);
+    std::atomic<int> finished(0);
+    std::atomic<int> zero_count(0);
+    std::atomic<int> released(0);
+    RefCountType *refs = nullptr;
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::mt19937 gen(id);
+            for (int r = 1; r <= rounds; r++)
+            {
+                while (round.load() != r)
+                    std::this_thread::yield();
+                int extra = 0;
+                for (int i = 0; i < my_op_count; i++)
+                {
+                    if (extra > 0 && gen() % 2 == 0)
+                    {
+                        assert(!refs->release(id));
+                        released.fetch_add(1);
+                        extra--;
+                    }
+                    else
+                    {
+                        refs->acquire(id);
+                        extra++;
+                    }
+                }
+                while (extra-- > 0)
+                {
+                    assert(!refs->release(id));
+                    released.fetch_add(1);
+                }
+                if (refs->release(id)) // the reference from the owner
+                    zero_count.fetch_add(1);
+                released.fetch_add(1);
+                finished.fetch_add(1);
+            } }));
+
+    for (int r = 1; r <= rounds; r++)
+    {
+        refs = new RefCountType(1, thread_count + 1);
+        for (int i = 0; i < thread_count; i++)
+            refs->acquire(thread_count);
+        zero_count.store(0);
+        finished.store(0);
+        round.store(r);
+        if (refs->release(thread_count))
+            zero_count.fetch_add(1);
+        while (finished.load() != thread_count)
+            std::this_thread::yield();
+        assert(zero_count.load() == 1);
+        assert(refs->count() == 0);
+        delete refs;
+    }
+    for (auto &t : threads)
+        t.join();
+    std::cout << released.load() << " releases, one zero per round" << std::endl
+              << std::endl;
+}
+
+template <typename Counter>
+void refcount_tests(const char *name)
+{
+    refcount_test<RefCount<Counter>>(name, 1, 200, 100);
+    refcount_test<RefCount<Counter>>(name, 4, 200, 100);
+    refcount_test<RefCount<Counter>>(name, 16, 50, 100);
+}
+
+int main(int argc, char const *argv[])
+{
+    refcount_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    refcount_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    return 0;
+}
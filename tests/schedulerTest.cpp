@@ -0,0 +1,58 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <iomanip>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/configuredAggregatingFunnelCounter.hpp"
+#include "../structures/sched/chunkScheduler.hpp"
+
+using namespace CHUNK_SCHEDULER;
+
+// Loops of different sizes and offsets back to back on one pool: every
+// iteration must run exactly once per loop
+template <typename Index>
+void scheduler_test(const char *name, int worker_count, Schedule schedule, long long min_chunk)
+{
+    std::cout << name << ": " << worker_count << " workers, schedule " << schedule << ", min chunk " << min_chunk << std::endl;
+    ChunkScheduler<Index> *scheduler = new ChunkScheduler<Index>(worker_count, schedule, min_chunk);
+    long long total = 0;
+    for (long long size : {0LL, 1LL, 7LL, 1000LL, 100000LL, 3LL})
+    {
+        long long begin = size % 13;
+        std::vector<std::atomic<int>> visited(size);
+        scheduler->parallel_for(begin, begin + size, [&](long long i)
+                                { visited[i - begin].fetch_add(1); });
+        for (long long i = 0; i < size; i++)
+            assert(visited[i].load() == 1);
+        total += size;
+    }
+    long long ran = 0;
+    for (int i = 0; i < worker_count; i++)
+        ran += scheduler->iteration_count(i);
+    assert(ran == total);
+    std::cout << "Ran each of " << total << " iterations once" << std::endl
+              << std::endl;
+    delete scheduler;
+}
+
+template <typename Index>
+void scheduler_tests(const char *name)
+{
+    for (Schedule schedule : {FIXED, GUIDED, TRAPEZOID})
+    {
+        scheduler_test<Index>(name, 1, schedule, 1);
+        scheduler_test<Index>(name, 4, schedule, 1);
+        scheduler_test<Index>(name, 8, schedule, 16);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    scheduler_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    scheduler_tests<CONFIGURED_AGG_FUNNEL::ConfiguredAggFunnelCounter<long long>>("ConfiguredAggFunnelCounter");
+    return 0;
+}
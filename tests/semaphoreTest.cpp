@@ -0,0 +1,107 @@
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+
+#include "../structures/counter/hardwareCounter.hpp"
+#include "../structures/counter/fullAggregatingFunnelCounter.hpp"
+#include "../structures/sync/funnelSemaphore.hpp"
+
+using namespace FUNNEL_SEMAPHORE;
+
+// Threads hold 1 to 3 permits at a time; the permits in use must never exceed
+// the initial count, and every permit must be back at the end.
+template <typename Semaphore>
+void semaphore_test(const char *name, int thread_count, long long permits, int my_op_count, bool bounded)
+{
+    std::cout << name << (bounded ? " (bounded)" : "") << ": " << thread_count << " threads, " << permits << " permits" << std::endl;
+    Semaphore *sem = new Semaphore(permits, thread_count);
+    std::atomic<long long> in_use(0);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            std::mt19937 gen(id);
+            for (int i = 0; i < my_op_count; i++)
+            {
+                long long k = gen() % 3 + 1;
+                if (bounded)
+                    sem->acquire_bounded(k, id);
+                else
+                    sem->acquire(k, id);
+                long long now = in_use.fetch_add(k) + k;
+                assert(now <= permits);
+                in_use.fetch_sub(k);
+                sem->release(k, id);
+            } }));
+    for (auto &t : threads)
+        t.join();
+    assert(sem->available() == permits);
+    assert(!sem->try_acquire(permits + 1, 0));
+    assert(sem->available() == permits);
+    std::cout << "Permits were never oversubscribed" << std::endl
+              << std::endl;
+    delete sem;
+}
+
+// A bucket starts full and refills at a fixed rate, so nothing can consume more
+// than capacity + rate * elapsed tokens
+template <typename Bucket>
+void token_bucket_test(const char *name, int thread_count)
+{
+    std::cout << name << ": " << thread_count << " threads" << std::endl;
+    const long long capacity = 100;
+    const double rate = 20000; // per second
+    Bucket *bucket = new Bucket(capacity, rate, thread_count);
+    std::atomic<long long> consumed(0);
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int id = 0; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int i = 0; i < 200; i++)
+            {
+                bucket->consume(1 + i % 2, id);
+                consumed.fetch_add(1 + i % 2);
+            }
+            while (bucket->try_consume(1, id))
+                consumed.fetch_add(1); }));
+    for (auto &t : threads)
+        t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Consumed " << consumed.load() << " tokens in " << seconds << "s" << std::endl;
+    assert(consumed.load() <= capacity + rate * seconds + 1);
+    assert(bucket->available() >= 0 && bucket->available() <= capacity);
+    std::cout << "Rate was respected" << std::endl
+              << std::endl;
+    delete bucket;
+}
+
+template <typename Counter>
+void sync_tests(const char *name)
+{
+    using Spin = WAIT_POLICY::SpinWait;
+    using Park = WAIT_POLICY::ParkWait;
+    for (bool bounded : {false, true})
+    {
+        semaphore_test<FunnelSemaphore<Counter, Spin>>(name, 4, 4, 20000, bounded);
+        semaphore_test<FunnelSemaphore<Counter, Park>>(name, 8, 3, 20000, bounded);
+        semaphore_test<FunnelSemaphore<Counter, Park>>(name, 32, 16, 5000, bounded);
+    }
+    token_bucket_test<TokenBucket<Counter, Spin>>(name, 4);
+    token_bucket_test<TokenBucket<Counter, Park>>(name, 16);
+}
+
+int main(int argc, char const *argv[])
+{
+    sync_tests<HARDWARE_ATOMIC::HardwareCounter<long long>>("HardwareCounter");
+    sync_tests<FULL_AGG_FUNNEL::FullAggFunnelCounter<long long>>("FullAggFunnelCounter");
+    return 0;
+}
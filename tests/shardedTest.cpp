@@ -0,0 +1,99 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include "../structures/counter/shardedCounter.hpp"
+
+using namespace SHARDED_COUNTER;
+
+// writer_count threads add 1 my_op_count times, announcing each add before
+// it starts and after it returns. reader_count threads take snapshots
+// meanwhile. A snapshot must lie between the adds that had returned before it
+// started and the adds that had started when it returned, and each reader's
+// snapshots must not go down.
+void snapshot_test(int writer_count, int reader_count, int max_collects, int my_op_count)
+{
+    std::cout << writer_count << " writers, " << reader_count << " readers, max collects " << max_collects << std::endl;
+    const long long start = 500;
+    int thread_count = writer_count + reader_count;
+    ShardedCounter<long long> counter(start, thread_count, max_collects);
+    std::vector<std::atomic<long long>> started(writer_count), done(writer_count);
+    std::atomic<int> writers_left(writer_count);
+    std::atomic<long long> snapshot_count(0);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < writer_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            for (int i = 0; i < my_op_count; i++)
+            {
+                started[id].store(i + 1);
+                counter.add(1, id);
+                done[id].store(i + 1);
+            }
+            writers_left.fetch_sub(1); }));
+    for (int id = writer_count; id < thread_count; id++)
+        threads.push_back(std::thread([&, id]()
+                                      {
+            long long last = start;
+            while (writers_left.load() > 0)
+            {
+                long long lower = start, upper = start;
+                for (int i = 0; i < writer_count; i++)
+                    lower += done[i].load();
+                long long value = counter.snapshot(id);
+                for (int i = 0; i < writer_count; i++)
+                    upper += started[i].load();
+                assert(lower <= value && value <= upper);
+                assert(value >= last);
+                last = value;
+                snapshot_count.fetch_add(1);
+            } }));
+    for (auto &t : threads)
+        t.join();
+
+    long long total = start + (long long)writer_count * my_op_count;
+    assert(counter.snapshot(0) == total);
+    assert(counter.approximate_sum() == total);
+    std::cout << snapshot_count.load() << " snapshots in bounds, final " << total << std::endl
+              << std::endl;
+}
+
+// Quiescent approximate sums are exact, including negative diffs
+void approximate_test(int thread_count, int my_op_count)
+{
+    std::cout << "Approximate sums with " << thread_count << " threads" << std::endl;
+    ShardedCounter<long long> counter(thread_count);
+    for (int round = 1; round <= 3; round++)
+    {
+        std::vector<std::thread> threads;
+        for (int id = 0; id < thread_count; id++)
+            threads.push_back(std::thread([&, id]()
+                                          {
+                for (int i = 0; i < my_op_count; i++)
+                    counter.add(id % 2 == 0 ? 3 : -1, id); }));
+        for (auto &t : threads)
+            t.join();
+        long long expected = 0;
+        for (int id = 0; id < thread_count; id++)
+            expected += (id % 2 == 0 ? 3LL : -1LL) * my_op_count * round;
+        assert(counter.approximate_sum() == expected);
+        assert(counter.snapshot(0) == expected);
+    }
+    std::cout << "Sums match" << std::endl
+              << std::endl;
+}
+
+int main(int argc, char const *argv[])
+{
+    approximate_test(1, 100000);
+    approximate_test(8, 20000);
+    snapshot_test(1, 1, ShardedCounter<long long>::DEFAULT_MAX_COLLECTS, 200000);
+    snapshot_test(4, 2, ShardedCounter<long long>::DEFAULT_MAX_COLLECTS, 100000);
+    snapshot_test(8, 4, 1, 50000);
+    snapshot_test(16, 4, 0, 20000);
+    return 0;
+}
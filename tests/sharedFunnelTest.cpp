@@ -0,0 +1,143 @@
+
+#include <atomic>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../structures/counter/sharedFunnelCounter.hpp"
+
+using namespace SHARED_FUNNEL;
+typedef SharedFunnelCounter<long long> Funnel;
+
+// Forked processes attach to one funnel and their threads add 1 at a time,
+// writing every returned value into a shared seen[] array. The values must be
+// exactly 0 .. total - 1, each once, and the root must end at total.
+void multi_process_test(int process_count, int threads_per_process, int fanout, int my_op_count, bool named)
+{
+    int slot_count = process_count * threads_per_process;
+    long long total = (long long)slot_count * my_op_count;
+    std::cout << process_count << " processes x " << threads_per_process << " threads, fanout " << fanout
+              << (named ? ", shm_open" : ", anonymous") << std::endl;
+
+    std::size_t funnel_bytes = Funnel::region_bytes(slot_count);
+    std::size_t seen_bytes = total * sizeof(std::atomic<int>);
+    std::string name = "/shared_funnel_test_" + std::to_string(getpid());
+    void *funnel_memory = named ? Funnel::map_named(name, funnel_bytes) : Funnel::map_anonymous(funnel_bytes);
+    std::atomic<int> *seen = (std::atomic<int> *)Funnel::map_anonymous(seen_bytes);
+
+    std::cout.flush();
+    std::vector<pid_t> children;
+    for (int p = 0; p < process_count; p++)
+    {
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0)
+        {
+            // Each child maps the named object again, as an unrelated process would
+            void *memory = named ? Funnel::map_named(name, funnel_bytes) : funnel_memory;
+            Funnel funnel(memory, funnel_bytes, slot_count, fanout);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threads_per_process; t++)
+                threads.push_back(std::thread([&]()
+                                              {
+                    int slot = funnel.register_slot();
+                    for (int i = 0; i < my_op_count; i++)
+                    {
+                        long long value = funnel.fetch_add(1, slot);
+                        assert(value >= 0 && value < total);
+                        seen[value].fetch_add(1);
+                    }
+                    funnel.unregister_slot(slot); }));
+            for (auto &t : threads)
+                t.join();
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    for (pid_t pid : children)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    Funnel funnel(funnel_memory, funnel_bytes, slot_count, fanout);
+    assert(funnel.load() == total);
+    for (long long i = 0; i < total; i++)
+        assert(seen[i].load() == 1);
+    std::cout << "Handed out 0.." << total - 1 << " once each" << std::endl
+              << std::endl;
+
+    Funnel::unmap(seen, seen_bytes);
+    Funnel::unmap(funnel_memory, funnel_bytes);
+    if (named)
+        shm_unlink(name.c_str());
+}
+
+// A process that exits without unregistering keeps its slot until someone
+// releases the slots of dead processes; the values it took stay taken
+void dead_slot_test()
+{
+    std::cout << "Slots of dead processes" << std::endl;
+    std::size_t bytes = Funnel::region_bytes(2);
+    void *memory = Funnel::map_anonymous(bytes);
+    Funnel funnel(memory, bytes, 2, 1, 100);
+    int slot = funnel.register_slot();
+
+    std::cout.flush();
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0)
+    {
+        Funnel child(memory, bytes, 2, 1);
+        int taken = child.register_slot();
+        for (int i = 0; i < 1000; i++)
+            child.fetch_add(1, taken);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    bool full = false;
+    try
+    {
+        funnel.register_slot();
+    }
+    catch (const std::runtime_error &)
+    {
+        full = true;
+    }
+    assert(full);
+    assert(funnel.release_dead_slots() == 1);
+    int reused = funnel.register_slot();
+    assert(reused != slot);
+
+    // Enough operations to cycle every pool share several times
+    long long ops = 4 * Funnel::POOL_PER_SLOT;
+    for (long long i = 0; i < ops; i++)
+    {
+        assert(funnel.fetch_add(1, slot) == 1100 + 2 * i);
+        assert(funnel.fetch_add(1, reused) == 1101 + 2 * i);
+    }
+    assert(funnel.load() == 1100 + 2 * ops);
+    std::cout << "Root at " << funnel.load() << std::endl
+              << std::endl;
+    Funnel::unmap(memory, bytes);
+}
+
+int main(int argc, char const *argv[])
+{
+    multi_process_test(1, 1, 1, 20000, false);
+    multi_process_test(2, 1, 1, 20000, false);
+    multi_process_test(4, 2, 2, 5000, false);
+    multi_process_test(3, 3, 4, 5000, true);
+    multi_process_test(8, 1, 3, 2000, false);
+    dead_slot_test();
+    return 0;
+}